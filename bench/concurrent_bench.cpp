@@ -0,0 +1,120 @@
+// Copyright message
+// нагрузочная проверка и масштабирование ConcurrentHashTable:
+// сначала потоки одновременно пишут и читают свои ключи со сверкой
+// значений, затем смесь 95% чтений / 5% записей на 1..N потоках
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "containers/ConcurrentHashTable.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+static void fail(const char* what) {
+    std::fprintf(stderr, "stress check failed: %s\n", what);
+    std::exit(1);
+}
+
+// каждый поток владеет своим диапазоном ключей и знает, что там должно
+// лежать; чужие диапазоны он только читает и проверяет формат значения
+static void stress(size_t threads, size_t keysPerThread) {
+    ConcurrentHashTable<std::string, std::string> table;
+    std::vector<std::thread> workers;
+
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&table, t, threads, keysPerThread] {
+            std::mt19937 gen(static_cast<uint32_t>(t));
+            for (size_t i = 0; i < keysPerThread; ++i) {
+                std::string key = "k" + std::to_string(t) + ":" + std::to_string(i);
+                table.insert(key, "v" + key);
+
+                if (i % 3 == 0) {
+                    table.remove(key);
+                    if (table.isPresent(key)) {
+                        fail("removed key is still present");
+                    }
+                    table.insert(key, "v" + key);
+                }
+
+                std::string value;
+                if (!table.find(key, value) || value != "v" + key) {
+                    fail("own key lost or corrupted");
+                }
+
+                size_t other = gen() % threads;
+                std::string foreign = "k" + std::to_string(other) + ":"
+                    + std::to_string(gen() % keysPerThread);
+                if (table.find(foreign, value) && value != "v" + foreign) {
+                    fail("foreign key has wrong value");
+                }
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    if (table.getSize() != threads * keysPerThread) {
+        fail("final size mismatch");
+    }
+    std::printf("stress: %zu threads x %zu keys ok\n", threads, keysPerThread);
+}
+
+static void scaling(size_t threads, size_t keys, size_t opsPerThread) {
+    ConcurrentHashTable<std::string, int> table;
+    std::vector<std::string> names;
+    names.reserve(keys);
+    for (size_t i = 0; i < keys; ++i) {
+        names.push_back("field:" + std::to_string(i));
+        table.insert(names.back(), static_cast<int>(i));
+    }
+
+    std::atomic<uint64_t> hits{0};
+    std::vector<std::thread> workers;
+    auto start = Clock::now();
+
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            std::mt19937 gen(static_cast<uint32_t>(t + 1));
+            uint64_t local = 0;
+            for (size_t i = 0; i < opsPerThread; ++i) {
+                const std::string& key = names[gen() % keys];
+                if (i % 20 == 0) {
+                    table.insert(key, static_cast<int>(i));
+                } else {
+                    local += table.isPresent(key);
+                }
+            }
+            hits += local;
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+    double mops = threads * opsPerThread / elapsed.count() / 1e6;
+    std::printf("%7zu %12.2f %12.2f\n", threads, mops, mops / threads);
+}
+
+int main(int argc, char* argv[]) {
+    size_t maxThreads = std::thread::hardware_concurrency();
+    if (argc > 1) {
+        maxThreads = std::stoul(argv[1]);
+    }
+    if (maxThreads == 0) {
+        maxThreads = 1;
+    }
+
+    stress(maxThreads < 4 ? 4 : maxThreads, 20000);
+
+    std::printf("%7s %12s %12s\n", "threads", "Mops/s", "per thread");
+    for (size_t threads = 1; threads <= maxThreads; threads *= 2) {
+        scaling(threads, 1000000, 2000000);
+    }
+    return 0;
+}
@@ -0,0 +1,115 @@
+// Copyright message
+// микробенчмарк хешеров HashTableOA: скорость хеширования, операции
+// с таблицей и длина проб на разных наборах ключей
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+#include "containers/HashTableOA.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+// не дает компилятору выбросить измеряемые вычисления
+volatile uint64_t benchSink;
+
+static double nsPerOp(Clock::time_point start, size_t ops) {
+    std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+    return elapsed.count() / static_cast<double>(ops);
+}
+
+static std::vector<std::string> sequentialKeys(size_t n) {
+    std::vector<std::string> keys;
+    keys.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        keys.push_back("user:" + std::to_string(i));
+    }
+    return keys;
+}
+
+static std::vector<std::string> randomKeys(size_t n, size_t minLen, size_t maxLen,
+                                           uint32_t seed) {
+    static const char alphabet[] =
+        "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789:_";
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<size_t> len(minLen, maxLen);
+    std::uniform_int_distribution<size_t> ch(0, sizeof(alphabet) - 2);
+
+    std::vector<std::string> keys;
+    keys.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        std::string key(len(gen), ' ');
+        for (char& c : key) {
+            c = alphabet[ch(gen)];
+        }
+        keys.push_back(std::move(key));
+    }
+    return keys;
+}
+
+template <typename Hasher>
+static void run(const char* hasherName, const char* setName,
+                const std::vector<std::string>& keys,
+                const std::vector<std::string>& misses) {
+    Hasher hasher;
+    uint64_t seed = hashing::randomSeed();
+    uint64_t sink = 0;
+    size_t bytes = 0;
+
+    auto start = Clock::now();
+    for (int rep = 0; rep < 5; ++rep) {
+        for (const auto& key : keys) {
+            sink ^= hasher(key, seed);
+            bytes += key.size();
+        }
+    }
+    double hashNs = nsPerOp(start, keys.size() * 5);
+    std::chrono::duration<double> hashTime = Clock::now() - start;
+
+    HashTableOA<std::string, int, Hasher> table(16);
+    start = Clock::now();
+    for (size_t i = 0; i < keys.size(); ++i) {
+        table.insert(keys[i], static_cast<int>(i));
+    }
+    double insertNs = nsPerOp(start, keys.size());
+
+    start = Clock::now();
+    for (const auto& key : keys) {
+        sink += *table.get(key);
+    }
+    double hitNs = nsPerOp(start, keys.size());
+
+    start = Clock::now();
+    for (const auto& key : misses) {
+        sink += table.get(key) != nullptr;
+    }
+    double missNs = nsPerOp(start, misses.size());
+
+    TableStats stats = table.getStats();
+
+    benchSink = sink;
+    std::printf("%-6s %-6s %8.1f %8.0f %8.1f %8.1f %8.1f %9.3f %9zu\n",
+                hasherName, setName, hashNs,
+                bytes / hashTime.count() / (1 << 20),
+                insertNs, hitNs, missNs, stats.avgProbe, stats.maxProbe);
+}
+
+template <typename Hasher>
+static void runAll(const char* name, size_t n) {
+    run<Hasher>(name, "seq", sequentialKeys(n), randomKeys(n, 8, 32, 7));
+    run<Hasher>(name, "rand", randomKeys(n, 8, 32, 1), randomKeys(n, 8, 32, 2));
+    run<Hasher>(name, "long", randomKeys(n, 64, 128, 3), randomKeys(n, 64, 128, 4));
+}
+
+int main(int argc, char* argv[]) {
+    size_t n = argc > 1 ? std::stoul(argv[1]) : 1000000;
+
+    std::printf("keys: %zu\n", n);
+    std::printf("%-6s %-6s %8s %8s %8s %8s %8s %9s %9s\n",
+                "hasher", "keys", "hash ns", "MB/s", "ins ns", "hit ns",
+                "miss ns", "avg probe", "max probe");
+    runAll<PolyHasher>("poly", n);
+    runAll<WyHasher>("wy", n);
+    runAll<XxHasher>("xx", n);
+    return 0;
+}
@@ -0,0 +1,145 @@
+// Copyright message
+// производители/потребители через очереди: проверка, что каждый элемент
+// доставлен ровно один раз, и пропускная способность MPMC-кольца
+// с блокирующим извлечением против std::deque под мьютексом
+// на 1..N парах потоков (и SPSC-кольца на одной паре)
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "containers/RingQueue.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+static void fail(const char* what) {
+    std::fprintf(stderr, "check failed: %s\n", what);
+    std::exit(1);
+}
+
+// базовый вариант: очередь под одной блокировкой
+class LockedQueue {
+ public:
+    explicit LockedQueue(size_t) {}
+
+    bool tryPush(uint64_t value) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            items.push_back(value);
+        }
+        ready.notify_one();
+        return true;
+    }
+
+    template <typename Rep, typename Period>
+    bool popWait(uint64_t& out, std::chrono::duration<Rep, Period> timeout) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!ready.wait_for(lock, timeout, [this] { return !items.empty(); })) {
+            return false;
+        }
+        out = items.front();
+        items.pop_front();
+        return true;
+    }
+
+ private:
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<uint64_t> items;
+};
+
+// элемент - номер производителя в старших битах и порядковый номер
+// в младших; потребители суммируют элементы и проверяют, что от каждого
+// производителя номера идут по возрастанию
+template <typename Queue>
+static double run(size_t producers, size_t consumers, size_t perProducer, bool check) {
+    Queue queue(4096);
+    std::atomic<size_t> consumed{0};
+    std::atomic<uint64_t> sum{0};
+    const size_t total = producers * perProducer;
+    std::vector<std::thread> threads;
+    auto start = Clock::now();
+
+    for (size_t p = 0; p < producers; ++p) {
+        threads.emplace_back([&, p] {
+            for (uint64_t i = 0; i < perProducer; ++i) {
+                uint64_t item = (static_cast<uint64_t>(p) << 40) | i;
+                while (!queue.tryPush(item)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    for (size_t c = 0; c < consumers; ++c) {
+        threads.emplace_back([&] {
+            std::vector<int64_t> last(producers, -1);
+            uint64_t local = 0;
+            uint64_t item;
+            while (consumed.load(std::memory_order_relaxed) < total) {
+                if (!queue.popWait(item, std::chrono::milliseconds(1))) {
+                    continue;
+                }
+                consumed.fetch_add(1, std::memory_order_relaxed);
+                uint64_t index = item & ((1ull << 40) - 1);
+                if (check) {
+                    int64_t& prev = last[item >> 40];
+                    if (static_cast<int64_t>(index) <= prev) {
+                        fail("items from one producer reordered");
+                    }
+                    prev = static_cast<int64_t>(index);
+                }
+                local += index;
+            }
+            sum += local;
+        });
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+
+    if (consumed.load() != total) {
+        fail("item count mismatch");
+    }
+    if (sum.load() != producers * (perProducer * (perProducer - 1) / 2)) {
+        fail("item sum mismatch");
+    }
+    return total / elapsed.count() / 1e6;
+}
+
+int main(int argc, char* argv[]) {
+    size_t maxThreads = std::thread::hardware_concurrency();
+    if (argc > 1) {
+        maxThreads = std::stoul(argv[1]);
+    }
+    if (maxThreads < 2) {
+        maxThreads = 2;
+    }
+
+    run<BlockingQueue<uint64_t>>(4, 4, 200000, true);
+    run<BlockingQueue<uint64_t, SpscQueue<uint64_t>>>(1, 1, 500000, true);
+    std::printf("check: mpmc 4x4 and spsc 1x1 ok\n");
+
+    const size_t items = 2000000;
+    std::printf("%5s %5s %12s %12s %12s\n", "prod", "cons", "mpmc Mops/s",
+                "mutex Mops/s", "spsc Mops/s");
+    for (size_t pairs = 1; pairs * 2 <= maxThreads; pairs *= 2) {
+        double mpmc = run<BlockingQueue<uint64_t>>(pairs, pairs, items / pairs, false);
+        double locked = run<LockedQueue>(pairs, pairs, items / pairs, false);
+        if (pairs == 1) {
+            double spsc = run<BlockingQueue<uint64_t, SpscQueue<uint64_t>>>(1, 1, items, false);
+            std::printf("%5zu %5zu %12.2f %12.2f %12.2f\n", pairs, pairs, mpmc, locked, spsc);
+        } else {
+            std::printf("%5zu %5zu %12.2f %12.2f %12s\n", pairs, pairs, mpmc, locked, "-");
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,155 @@
+// Copyright message
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "./HashTableOA.hpp"
+
+// счетчики и оценки фильтра для SSTATS
+struct BloomStats {
+    bool enabled = false;
+    double targetFpr = 0.0;
+    double estimatedFpr = 0.0;  // по заполненности битов
+    size_t capacity = 0;        // на сколько элементов рассчитан
+    size_t blocks = 0;
+    size_t bytes = 0;
+    size_t removed = 0;         // удалений с последней перестройки
+    size_t checks = 0;
+    size_t negatives = 0;       // отсечено без обращения к таблице
+    size_t falsePositives = 0;
+};
+
+// блочный фильтр Блума: ключ попадает в один блок размером с кэш-линию
+// и выставляет в нем по одному биту в каждом из 8 слов, так что проверка -
+// одна загрузка линии и 8 независимых and без ветвлений (векторизуется).
+// Удалять из фильтра нельзя, поэтому владелец считает удаления
+// и перестраивает фильтр, когда их накопилось много
+template <typename Key, typename Hasher = WyHasher>
+class BloomFilter {
+ public:
+    using KeyView = std::conditional_t<std::is_same_v<Key, std::string>,
+                                       std::string_view, const Key&>;
+
+    static constexpr size_t MIN_CAPACITY = 1024;
+
+    explicit BloomFilter(double targetFpr = 0.01, size_t expected = 0)
+        : fpr(targetFpr), seed(hashing::randomSeed()) {
+        resize(expected);
+    }
+
+    void add(KeyView key) {
+        uint64_t h = hashKey<Key>(hasher, key, seed);
+        Block& block = blocks[blockIndex(h)];
+        uint32_t low = static_cast<uint32_t>(h);
+        for (size_t i = 0; i < WORDS; ++i) {
+            block.words[i] |= bitFor(low, i);
+        }
+    }
+
+    // false - ключа точно нет; true - возможно есть
+    bool mayContain(KeyView key) const {
+        uint64_t h = hashKey<Key>(hasher, key, seed);
+        const Block& block = blocks[blockIndex(h)];
+        uint32_t low = static_cast<uint32_t>(h);
+        uint64_t missing = 0;
+        for (size_t i = 0; i < WORDS; ++i) {
+            missing |= bitFor(low, i) & ~block.words[i];
+        }
+        return missing == 0;
+    }
+
+    void noteRemoval() {
+        removed++;
+    }
+
+    // пора перестраивать: элементов больше расчетного
+    // или удаленные занимают заметную долю битов
+    bool needsRebuild(size_t liveSize) const {
+        return liveSize > capacity || removed * 4 > capacity;
+    }
+
+    // forEach(add) должен пройти по всем живым элементам
+    template <typename ForEach>
+    void rebuild(size_t liveSize, ForEach&& forEach) {
+        resize(liveSize * 2);
+        forEach([this](KeyView key) { add(key); });
+    }
+
+    double targetFpr() const {
+        return fpr;
+    }
+
+    // для одного бита на слово вероятность ложного срабатывания в блоке -
+    // произведение долей единиц в его словах; усредняется по блокам
+    double estimatedFpr() const {
+        double sum = 0.0;
+        for (const Block& block : blocks) {
+            double p = 1.0;
+            for (size_t i = 0; i < WORDS; ++i) {
+                p *= __builtin_popcountll(block.words[i]) / 64.0;
+            }
+            sum += p;
+        }
+        return blocks.empty() ? 0.0 : sum / blocks.size();
+    }
+
+    BloomStats getStats() const {
+        BloomStats stats;
+        stats.enabled = true;
+        stats.targetFpr = fpr;
+        stats.estimatedFpr = estimatedFpr();
+        stats.capacity = capacity;
+        stats.blocks = blocks.size();
+        stats.bytes = sizeof(*this) + blocks.capacity() * sizeof(Block);
+        stats.removed = removed;
+        return stats;
+    }
+
+ private:
+    static constexpr size_t WORDS = 8;
+
+    struct alignas(64) Block {
+        uint64_t words[WORDS];
+    };
+
+    // нечетные множители дают 8 независимых номеров бита из 32 бит хеша
+    static constexpr uint32_t SALT[WORDS] = {
+        0x47b6137bu, 0x44974d91u, 0x8824ad5bu, 0xa2b7289du,
+        0x705495c7u, 0x2df1424bu, 0x9efc4947u, 0x5c6bfb31u};
+
+    std::vector<Block> blocks;
+    double fpr;
+    size_t capacity = 0;
+    size_t removed = 0;
+    uint64_t seed;
+    Hasher hasher;
+
+    static uint64_t bitFor(uint32_t low, size_t i) {
+        return 1ull << ((low * SALT[i]) >> 26);
+    }
+
+    // старшие 32 бита хеша отображаются на [0, blocks) умножением
+    size_t blockIndex(uint64_t h) const {
+        return static_cast<size_t>(((h >> 32) * blocks.size()) >> 32);
+    }
+
+    // битов на элемент столько, чтобы оценка (1 - e^(-8/b))^8 с запасом
+    // на неравномерность блоков не превышала целевой вероятности
+    static double bitsPerElement(double target) {
+        double bits = 8.0;
+        while (bits < 64.0
+                && 1.25 * std::pow(1.0 - std::exp(-8.0 / bits), 8.0) > target) {
+            bits += 0.5;
+        }
+        return bits;
+    }
+
+    void resize(size_t expected) {
+        capacity = expected < MIN_CAPACITY ? MIN_CAPACITY : expected;
+        size_t bits = static_cast<size_t>(capacity * bitsPerElement(fpr));
+        size_t count = (bits + 511) / 512;
+        blocks.assign(count, Block{});
+        removed = 0;
+    }
+};
@@ -0,0 +1,271 @@
+// Copyright message
+#pragma once
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "./HashTableOA.hpp"
+#include "../utils/StringUtils.hpp"
+
+// пороги компактного представления, задаются из командной строки
+struct CompactLimits {
+    // сколько элементов держится в плоском массиве
+    static inline size_t maxEntries = 64;
+    // ключ или значение длиннее этого сразу переводят в хеш-таблицу
+    static inline size_t maxElementBytes = 64;
+};
+
+// маленькие коллекции хранятся плоским массивом пар с линейным поиском
+// (как listpack в Redis); при превышении порогов содержимое один раз
+// переносится в HashTableOA и дальше работает как обычная таблица
+template <typename Key, typename Value, typename Hasher = WyHasher>
+class CompactTable {
+ public:
+    using Table = HashTableOA<Key, Value, Hasher>;
+    using KeyView = typename Table::KeyView;
+
+    CompactTable() = default;
+
+    // ожидаемый размер больше порога - сразу заводим таблицу
+    explicit CompactTable(int capacity) {
+        if (capacity > 0 && static_cast<size_t>(capacity) > CompactLimits::maxEntries) {
+            table = std::make_unique<Table>(capacity);
+        } else if (capacity > 0) {
+            entries.reserve(capacity);
+        }
+    }
+
+    CompactTable(const CompactTable& other)
+        : entries(other.entries),
+          table(other.table ? std::make_unique<Table>(*other.table) : nullptr) {}
+
+    CompactTable(CompactTable&&) noexcept = default;
+
+    CompactTable& operator=(const CompactTable& other) {
+        if (this != &other) {
+            CompactTable tmp(other);
+            *this = std::move(tmp);
+        }
+        return *this;
+    }
+
+    CompactTable& operator=(CompactTable&&) noexcept = default;
+
+    bool insert(const Key& key, const Value& value) {
+        return insertImpl(key, value);
+    }
+
+    bool insert(Key&& key, Value&& value) {
+        return insertImpl(std::move(key), std::move(value));
+    }
+
+    template <typename K, typename... Args>
+    bool emplace(K&& key, Args&&... args) {
+        return insertImpl(std::forward<K>(key), Value(std::forward<Args>(args)...));
+    }
+
+    const Value* get(KeyView key) const {
+        if (table) {
+            return table->get(key);
+        }
+
+        for (const Entry& entry : entries) {
+            if (entry.first == key) {
+                return &entry.second;
+            }
+        }
+        return nullptr;
+    }
+
+    Value* get(KeyView key) {
+        return const_cast<Value*>(std::as_const(*this).get(key));
+    }
+
+    bool isPresent(KeyView key) const {
+        return get(key) != nullptr;
+    }
+
+    Value find(KeyView key) const {
+        const Value* value = get(key);
+        return value ? *value : Value();
+    }
+
+    // порядок в массиве не важен, поэтому удаляемый элемент
+    // замещается последним
+    bool remove(KeyView key) {
+        if (table) {
+            return table->remove(key);
+        }
+
+        for (size_t i = 0; i < entries.size(); ++i) {
+            if (entries[i].first == key) {
+                if (i + 1 != entries.size()) {
+                    entries[i] = std::move(entries.back());
+                }
+                entries.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    size_t getSize() const {
+        return table ? table->getSize() : entries.size();
+    }
+
+    bool isCompact() const {
+        return !table;
+    }
+
+    // компактная форма мала и отдается целиком за один вызов
+    template <typename Fn>
+    uint64_t scan(uint64_t cursor, size_t count, Fn&& fn) const {
+        if (table) {
+            return table->scan(cursor, count, fn);
+        }
+
+        for (const Entry& entry : entries) {
+            fn(entry.first, entry.second);
+        }
+        return 0;
+    }
+
+    template <typename Fn>
+    void forEach(Fn&& fn) const {
+        forEachPartition(0, 1, fn);
+    }
+
+    // часть part из parts для параллельного обхода; компактная форма
+    // целиком достается первой части
+    template <typename Fn>
+    void forEachPartition(size_t part, size_t parts, Fn&& fn) const {
+        if (!table) {
+            if (part == 0) {
+                for (const Entry& entry : entries) {
+                    fn(entry.first, entry.second);
+                }
+            }
+            return;
+        }
+
+        size_t slots = table->slotCount();
+        size_t chunk = (slots + parts - 1) / parts;
+        table->forEachInRange(part * chunk, (part + 1) * chunk, fn);
+    }
+
+    TableStats getStats() const {
+        if (table) {
+            TableStats stats = table->getStats();
+            stats.bytes += sizeof(*this);
+            return stats;
+        }
+
+        TableStats stats;
+        stats.encoding = "compact";
+        stats.size = entries.size();
+        stats.capacity = entries.capacity();
+        if (stats.capacity > 0) {
+            stats.loadFactor = static_cast<float>(stats.size) / stats.capacity;
+        }
+        // для массива "проба" - число сравнений при линейном поиске
+        stats.avgProbe = stats.size > 0 ? (stats.size + 1) / 2.0 : 0.0;
+        stats.maxProbe = stats.size;
+        stats.bytes = sizeof(*this) + entries.capacity() * sizeof(Entry);
+        for (const Entry& entry : entries) {
+            stats.bytes += heapBytes(entry.first) + heapBytes(entry.second);
+        }
+        return stats;
+    }
+
+    void print() const {
+        if (table) {
+            table->print();
+            return;
+        }
+
+        for (size_t i = 0; i < entries.size(); ++i) {
+            std::cout << "[" << i << "] {" << entries[i].first
+                << ": " << entries[i].second << "}" << std::endl;
+        }
+    }
+
+    void saveKeysToStream(std::ostream& out) const {
+        if (table) {
+            table->saveKeysToStream(out);
+            return;
+        }
+
+        for (const Entry& entry : entries) {
+            out << StringUtils::toStringValue<Key>(entry.first) << "|";
+        }
+    }
+
+    void savePairsToStream(std::ostream& out) const {
+        if (table) {
+            table->savePairsToStream(out);
+            return;
+        }
+
+        for (const Entry& entry : entries) {
+            out << StringUtils::toStringValue<Key>(entry.first) << ":"
+                << StringUtils::toStringValue<Value>(entry.second) << "|";
+        }
+    }
+
+ private:
+    using Entry = std::pair<Key, Value>;
+
+    std::vector<Entry> entries;
+    std::unique_ptr<Table> table;
+
+    template <typename T>
+    static size_t elementBytes(const T& value) {
+        if constexpr (std::is_arithmetic_v<T>) {
+            return sizeof(T);
+        } else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+            return std::string_view(value).size();
+        } else {
+            return value.byteSize();
+        }
+    }
+
+    template <typename K, typename V>
+    bool insertImpl(K&& key, V&& value) {
+        if (table) {
+            return table->emplace(std::forward<K>(key), std::forward<V>(value));
+        }
+
+        if (Value* existing = get(key)) {
+            *existing = std::forward<V>(value);
+            if (elementBytes(*existing) > CompactLimits::maxElementBytes) {
+                convert();
+            }
+            return true;
+        }
+
+        if (entries.size() + 1 > CompactLimits::maxEntries
+                || elementBytes(KeyView(key)) > CompactLimits::maxElementBytes
+                || elementBytes(value) > CompactLimits::maxElementBytes) {
+            convert();
+            return table->emplace(std::forward<K>(key), std::forward<V>(value));
+        }
+
+        entries.emplace_back(Key(std::forward<K>(key)), std::forward<V>(value));
+        return true;
+    }
+
+    // однократный перенос массива в хеш-таблицу
+    void convert() {
+        auto converted = std::make_unique<Table>(static_cast<int>(entries.size() * 2));
+        for (Entry& entry : entries) {
+            converted->insert(std::move(entry.first), std::move(entry.second));
+        }
+
+        std::vector<Entry>().swap(entries);
+        table = std::move(converted);
+    }
+};
@@ -0,0 +1,110 @@
+// Copyright message
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+#include "./HashTableOA.hpp"
+
+// потокобезопасная таблица: ключи раскладываются по независимым шардам
+// по старшим битам хеша, у каждого шарда своя блокировка чтения-записи,
+// поэтому читатели разных (и одного) шардов не мешают друг другу
+template <typename Key, typename Value, typename Hasher = WyHasher>
+class ConcurrentHashTable {
+ public:
+    using Table = HashTableOA<Key, Value, Hasher>;
+    using KeyView = typename Table::KeyView;
+
+    explicit ConcurrentHashTable(size_t shardCount = 64, int shardCapacity = 16)
+        : seed(hashing::randomSeed()) {
+        size_t count = 1;
+        shardBits = 0;
+        while (count < shardCount) {
+            count <<= 1;
+            shardBits++;
+        }
+
+        // все шарды используют один seed: хеш считается один раз,
+        // старшие биты выбирают шард, младшие - группу внутри него
+        for (size_t i = 0; i < count; ++i) {
+            shards.push_back(std::make_unique<Shard>(shardCapacity, seed));
+        }
+    }
+
+    ConcurrentHashTable(const ConcurrentHashTable&) = delete;
+    ConcurrentHashTable& operator=(const ConcurrentHashTable&) = delete;
+
+    bool insert(const Key& key, const Value& value) {
+        size_t h = shards[0]->table.hashOf(key);
+        Shard& shard = shardFor(h);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        return shard.table.insert(key, value, h);
+    }
+
+    bool remove(KeyView key) {
+        size_t h = shards[0]->table.hashOf(key);
+        Shard& shard = shardFor(h);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        return shard.table.remove(key, h);
+    }
+
+    bool isPresent(KeyView key) const {
+        size_t h = shards[0]->table.hashOf(key);
+        const Shard& shard = shardFor(h);
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        return shard.table.get(key, h) != nullptr;
+    }
+
+    // значение копируется под блокировкой, указатель наружу не отдается
+    bool find(KeyView key, Value& out) const {
+        return visit(key, [&out](const Value& value) { out = value; });
+    }
+
+    // вызывает fn(const Value&) под разделяемой блокировкой шарда
+    template <typename Fn>
+    bool visit(KeyView key, Fn&& fn) const {
+        size_t h = shards[0]->table.hashOf(key);
+        const Shard& shard = shardFor(h);
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        const Value* value = shard.table.get(key, h);
+        if (!value) {
+            return false;
+        }
+        fn(*value);
+        return true;
+    }
+
+    // сумма по шардам; при параллельных записях это лишь оценка
+    size_t getSize() const {
+        size_t size = 0;
+        for (const auto& shard : shards) {
+            std::shared_lock<std::shared_mutex> lock(shard->mutex);
+            size += shard->table.getSize();
+        }
+        return size;
+    }
+
+    size_t getShardCount() const {
+        return shards.size();
+    }
+
+ private:
+    // шард занимает свои кэш-линии, чтобы блокировки соседей не делили их
+    struct alignas(64) Shard {
+        mutable std::shared_mutex mutex;
+        Table table;
+
+        Shard(int capacity, uint64_t seed) : table(capacity, seed) {}
+    };
+
+    std::vector<std::unique_ptr<Shard>> shards;
+    size_t shardBits;
+    uint64_t seed;
+
+    Shard& shardFor(size_t h) const {
+        size_t index = shardBits == 0 ? 0 : (h >> (64 - shardBits));
+        return *shards[index];
+    }
+};
@@ -0,0 +1,77 @@
+// Copyright message
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// управляющие байты swiss-таблицы: старший бит выставлен у пустых
+// и удаленных ячеек, у занятых хранится 7-битный фрагмент хеша
+const int8_t CTRL_EMPTY = -128;
+const int8_t CTRL_DELETED = -2;
+const size_t GROUP_WIDTH = 16;
+
+// группа из 16 управляющих байтов, сравнивается за одну SSE2 инструкцию
+class ControlGroup {
+ public:
+    explicit ControlGroup(const int8_t* ctrl) {
+#if defined(__SSE2__)
+        bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl));
+#else
+        for (size_t i = 0; i < GROUP_WIDTH; ++i) {
+            bytes[i] = ctrl[i];
+        }
+#endif
+    }
+
+    // битовая маска ячеек, у которых фрагмент хеша равен h2
+    uint32_t match(int8_t h2) const {
+#if defined(__SSE2__)
+        return static_cast<uint32_t>(
+            _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), bytes)));
+#else
+        return matchIf([h2](int8_t c) { return c == h2; });
+#endif
+    }
+
+    uint32_t matchEmpty() const {
+        return match(CTRL_EMPTY);
+    }
+
+    uint32_t matchEmptyOrDeleted() const {
+#if defined(__SSE2__)
+        return static_cast<uint32_t>(_mm_movemask_epi8(bytes));
+#else
+        return matchIf([](int8_t c) { return c < 0; });
+#endif
+    }
+
+    uint32_t matchFull() const {
+        return ~matchEmptyOrDeleted() & 0xFFFFu;
+    }
+
+    static size_t lowestBit(uint32_t mask) {
+        return static_cast<size_t>(__builtin_ctz(mask));
+    }
+
+ private:
+#if defined(__SSE2__)
+    __m128i bytes;
+#else
+    int8_t bytes[GROUP_WIDTH];
+
+    template <typename Pred>
+    uint32_t matchIf(Pred pred) const {
+        uint32_t mask = 0;
+        for (size_t i = 0; i < GROUP_WIDTH; ++i) {
+            if (pred(bytes[i])) {
+                mask |= 1u << i;
+            }
+        }
+        return mask;
+    }
+#endif
+};
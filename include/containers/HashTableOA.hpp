@@ -2,240 +2,719 @@
 #pragma once
 #include <iostream>
 #include <string>
-#include <random>
+#include <string_view>
+#include <cstring>
 #include <utility>
 #include <type_traits>
 #include <fstream>
+#include "./ControlGroup.hpp"
+#include "./Hashers.hpp"
 #include "../utils/StringUtils.hpp"
 
-template <typename Key, typename Value>
+// порог заполнения (с учетом удаленных ячеек), после которого таблица растет
+const float HT_MAX_LOAD_FACTOR = 0.875f;
+// сколько ячеек старой таблицы переносится за одну операцию при рехеше
+const size_t HT_REHASH_STEP = GROUP_WIDTH;
+const size_t HT_MIN_CAPACITY = GROUP_WIDTH;
+// доля удаленных ячеек, при которой таблица перестраивается без роста
+const float HT_MAX_TOMBSTONE_RATIO = 0.25f;
+
+// снимок внутреннего состояния таблицы для HSTATS/SSTATS/MEMORY USAGE
+struct TableStats {
+    size_t size = 0;
+    size_t capacity = 0;
+    float loadFactor = 0.0f;
+    size_t tombstones = 0;
+    double avgProbe = 0.0;   // в группах, 1 - ключ лежит в своей группе
+    size_t maxProbe = 0;
+    size_t bytes = 0;        // приблизительно, вместе с памятью строк
+    bool rehashing = false;
+    const char* encoding = "hashtable";
+};
+
+// память в куче, которую значение занимает помимо своей ячейки
+template <typename T>
+size_t heapBytes(const T& value) {
+    if constexpr (std::is_same_v<T, std::string>) {
+        static const size_t inlineCapacity = std::string().capacity();
+        return value.capacity() > inlineCapacity ? value.capacity() + 1 : 0;
+    } else {
+        (void)value;
+        return 0;
+    }
+}
+
+// хеш ключа: числа идут в хешер машинным словом, строки - байтами,
+// остальные типы хешируют себя сами методом hash(hasher, seed)
+template <typename Key, typename Hasher, typename View>
+uint64_t hashKey(const Hasher& hasher, const View& key, uint64_t seed) {
+    if constexpr (std::is_integral_v<Key>) {
+        return hasher(static_cast<uint64_t>(key), seed);
+    } else if constexpr (std::is_floating_point_v<Key>) {
+        // 0.0 и -0.0 равны как ключи, поэтому хешируются одинаково
+        double d = key == 0 ? 0.0 : static_cast<double>(key);
+        uint64_t bits;
+        std::memcpy(&bits, &d, sizeof(bits));
+        return hasher(bits, seed);
+    } else if constexpr (std::is_convertible_v<const View&, std::string_view>) {
+        return hasher(std::string_view(key), seed);
+    } else {
+        return key.hash(hasher, seed);
+    }
+}
+
+template <typename Key, typename Value, typename Hasher = WyHasher>
 class HashTableOA {
  public:
+    // для строковых ключей поиск принимает std::string_view без копирования
+    using KeyView = std::conditional_t<std::is_same_v<Key, std::string>,
+                                       std::string_view, const Key&>;
+
     explicit HashTableOA(int capacity)
-        : size(0), capacity(capacity), loadFactor(0.0f), p(1000000007) {
-        table = new Cell[capacity];
-        init();
+        : HashTableOA(capacity, hashing::randomSeed()) {}
+
+    // явный seed нужен, когда хеш считается снаружи (см. ConcurrentHashTable)
+    HashTableOA(int capacity, uint64_t seed)
+        : rehashIdx(-1), seed(seed) {
+        allocate(ht[0], roundCapacity(capacity));
     }
 
     HashTableOA() : HashTableOA(1000) {}  // конструктор по умолчанию
 
 
     HashTableOA(const HashTableOA& other)
-        : size(other.getSize()),
-          capacity(other.getCapacity()),
-          loadFactor(other.getLoadFactor()),
-          a(other.a),
-          b(other.b),
-          p(other.p) {
-            table = new Cell[other.getCapacity()];
-            for (size_t i = 0; i < capacity; i++) {
-                table[i] = other.table[i];
-            }
+        : rehashIdx(other.rehashIdx),
+          seed(other.seed) {
+            copyTable(ht[0], other.ht[0]);
+            copyTable(ht[1], other.ht[1]);
           }
 
+    // после перемещения исходная таблица пуста и без памяти,
+    // первая вставка сама выделит минимальную емкость
+    HashTableOA(HashTableOA&& other) noexcept
+        : rehashIdx(other.rehashIdx),
+          seed(other.seed) {
+        ht[0] = other.ht[0];
+        ht[1] = other.ht[1];
+        other.ht[0] = Table();
+        other.ht[1] = Table();
+        other.rehashIdx = -1;
+    }
+
     HashTableOA& operator=(const HashTableOA& other) {
         if (this != &other) {
-            HashTableOA<Key, Value> tmp(other);
+            HashTableOA tmp(other);
             swap(tmp);
         }
 
         return *this;
     }
 
+    HashTableOA& operator=(HashTableOA&& other) noexcept {
+        if (this != &other) {
+            clean();
+            swap(other);
+        }
+
+        return *this;
+    }
+
     ~HashTableOA() {
         clean();
     }
 
     bool insert(const Key& key, const Value& value) {
-        size_t index;
-        for (size_t i = 0; i < capacity; i++) {
-            index = (h1(key) + i) % capacity;
-
-            if (!table[index].isOccupied || table[index].isDeleted) {
-                table[index].key = key;
-                table[index].value = value;
-                table[index].isOccupied = true;
-                table[index].isDeleted = false;
-                size++;
-                loadFactor = getLoadFactor();
-                return true;
-            }
-
-            if (table[index].isOccupied && !table[index].isDeleted
-                    && table[index].key == key) {
-                table[index].value = value;
-                return true;
-            }
-        }
-
-        std::cerr << "Error: table is full!" << std::endl;
-        return false;
+        return insertHashed(key, value, hash(key));
     }
 
+    bool insert(Key&& key, Value&& value) {
+        size_t h = hash(key);
+        return insertHashed(std::move(key), std::move(value), h);
+    }
 
-    bool isPresent(const Key& key) const {
-        size_t h = h1(key);
+    // перегрузки с готовым хешем: h должен быть получен через hashOf()
+    bool insert(const Key& key, const Value& value, size_t h) {
+        return insertHashed(key, value, h);
+    }
 
-        for (size_t i = 0; i < capacity; i++) {
-            size_t index = (h + i) % capacity;
-            const Cell& cell = table[index];
+    // значение строится из args; ключ может быть и KeyView - тогда
+    // Key создается только если такого ключа в таблице еще нет
+    template <typename K, typename... Args>
+    bool emplace(K&& key, Args&&... args) {
+        size_t h = hash(key);
+        return insertHashed(std::forward<K>(key),
+                            Value(std::forward<Args>(args)...), h);
+    }
 
-            if (!cell.isOccupied && !cell.isDeleted) {
-                return false;
-            }
-            if (cell.isOccupied && !cell.isDeleted && cell.key == key) {
-                return true;
-            }
+    // как std::map::try_emplace: значение строится из args, только если
+    // ключа еще нет. Одна проба на существующий ключ; указатель на
+    // значение и признак вставки
+    template <typename K, typename... Args>
+    std::pair<Value*, bool> tryEmplace(K&& key, Args&&... args) {
+        size_t h = hash(key);
+        rehashStep();
+        if (const Value* existing = get(key, h)) {
+            return {const_cast<Value*>(existing), false};
         }
 
-        return false;
+        expandIfNeeded();
+        Table& target = isRehashing() ? ht[1] : ht[0];
+        Slot* slot = place(target, std::forward<K>(key),
+                           Value(std::forward<Args>(args)...), h);
+        return {&slot->value, true};
     }
 
 
-    Value find(const Key& key) const {
-        size_t h = h1(key);
+    bool isPresent(KeyView key) const {
+        return get(key) != nullptr;
+    }
 
-        for (size_t i = 0; i < capacity; i++) {
-            size_t index = (h + i) % capacity;
 
-            const Cell& cell = table[index];
+    // указатель на хранимое значение или nullptr, если ключа нет
+    const Value* get(KeyView key) const {
+        return get(key, hash(key));
+    }
 
-            if (!cell.isOccupied && !cell.isDeleted) {
-                return Value();
-            }
+    Value* get(KeyView key) {
+        return const_cast<Value*>(std::as_const(*this).get(key));
+    }
 
-            if (cell.isOccupied && !cell.isDeleted && cell.key == key) {
-                return cell.value;
-            }
+    const Value* get(KeyView key, size_t h) const {
+        const Slot* slot = lookup(ht[0], key, h);
+        if (!slot && isRehashing()) {
+            slot = lookup(ht[1], key, h);
         }
 
-        return Value();
+        return slot ? &slot->value : nullptr;
     }
 
 
-    bool remove(const Key& key) {
-        size_t index;
-        for (size_t i = 0; i < capacity; i++) {
-            index = (h1(key) + i) % capacity;
-            if (!table[index].isOccupied && !table[index].isDeleted) {
-                return false;
-            }
-            if (table[index].isOccupied && table[index].key == key) {
-                table[index].isDeleted = true;
-                table[index].isOccupied = false;
-                size--;
-                loadFactor = getLoadFactor();
-                return true;
-            }
+    Value find(KeyView key) const {
+        const Value* value = get(key);
+        return value ? *value : Value();
+    }
+
+
+    bool remove(KeyView key) {
+        return remove(key, hash(key));
+    }
+
+    bool remove(KeyView key, size_t h) {
+        rehashStep();
+
+        if (erase(ht[0], key, h)) {
+            compactIfNeeded();
+            return true;
         }
-        return false;
+
+        return isRehashing() && erase(ht[1], key, h);
     }
 
 
     void print() const {
-        for (size_t i = 0; i < capacity; i++) {
-            std::cout << "[" << i << "]";
-            if (table[i].isOccupied) {
-                std::cout << " {" << table[i].key
-                    << ": " << table[i].value << "}";
-            } else if (table[i].isDeleted) {
-                std::cout << "(deleted)";
-            }
-            std::cout << std::endl;
+        printTable(ht[0]);
+        if (isRehashing()) {
+            std::cout << "(rehashing into " << ht[1].capacity << " cells)\n";
+            printTable(ht[1]);
         }
     }
 
     void clean() {
-        delete[] table;
-        table = nullptr;
-        size = 0;
-        loadFactor = 0.0f;
+        release(ht[0]);
+        release(ht[1]);
+        rehashIdx = -1;
     }
 
 
     size_t getSize() const {
-        return size;
+        return ht[0].size + ht[1].size;
     }
 
 
+    // емкость таблицы, в которую идут новые элементы
     size_t getCapacity() const {
-        return capacity;
+        return isRehashing() ? ht[1].capacity : ht[0].capacity;
     }
 
 
     float getLoadFactor() const {
-        if (capacity == 0) {
+        if (getCapacity() == 0) {
             return 0.0f;
         }
 
-        return static_cast<float>(size) / capacity;
+        return static_cast<float>(getSize()) / getCapacity();
+    }
+
+    bool isRehashing() const {
+        return rehashIdx != -1;
+    }
+
+    size_t hashOf(KeyView key) const {
+        return hash(key);
+    }
+
+    // инкрементальный обход: за вызов передает fn(key, value) элементы
+    // примерно count ячеек-групп и возвращает курсор продолжения (0 - конец).
+    // Курсор - номер домашней группы, увеличиваемый в обратном порядке бит,
+    // поэтому элементы, прожившие весь обход, выдаются хотя бы раз даже при
+    // росте таблицы между вызовами; повторы возможны
+    template <typename Fn>
+    uint64_t scan(uint64_t cursor, size_t count, Fn&& fn) const {
+        size_t emitted = 0;
+        size_t visits = count * 10;
+        do {
+            cursor = scanStep(cursor, emitted, fn);
+        } while (cursor != 0 && emitted < count && --visits > 0);
+        return cursor;
+    }
+
+    // проходит по всей таблице, поэтому для диагностики, а не для горячего пути
+    TableStats getStats() const {
+        TableStats stats;
+        stats.size = getSize();
+        stats.capacity = getCapacity();
+        stats.loadFactor = getLoadFactor();
+        stats.tombstones = ht[0].deleted + ht[1].deleted;
+        stats.rehashing = isRehashing();
+        stats.bytes = sizeof(*this);
+
+        size_t totalProbe = 0;
+        for (const Table& t : ht) {
+            stats.bytes += t.capacity * (sizeof(Slot) + sizeof(int8_t));
+            for (size_t i = 0; i < t.capacity; ++i) {
+                if (t.ctrl[i] < 0) {
+                    continue;
+                }
+
+                size_t probe = probeLength(t, i);
+                totalProbe += probe;
+                if (probe > stats.maxProbe) {
+                    stats.maxProbe = probe;
+                }
+                stats.bytes += heapBytes(t.slots[i].key) + heapBytes(t.slots[i].value);
+            }
+        }
+
+        if (stats.size > 0) {
+            stats.avgProbe = static_cast<double>(totalProbe) / stats.size;
+        }
+        return stats;
+    }
+
+    // fn(key, value) для всех живых элементов в порядке ячеек
+    template <typename Fn>
+    void forEach(Fn&& fn) const {
+        forEachInRange(0, slotCount(), fn);
+    }
+
+    // ячейки обеих таблиц нумеруются как один диапазон [0, slotCount()),
+    // непересекающиеся поддиапазоны можно обходить из разных потоков
+    size_t slotCount() const {
+        return ht[0].capacity + ht[1].capacity;
+    }
+
+    template <typename Fn>
+    void forEachInRange(size_t begin, size_t end, Fn&& fn) const {
+        for (const Table& t : ht) {
+            size_t first = begin < t.capacity ? begin : t.capacity;
+            size_t last = end < t.capacity ? end : t.capacity;
+            for (size_t i = first; i < last; ++i) {
+                if (t.ctrl[i] >= 0) {
+                    fn(t.slots[i].key, t.slots[i].value);
+                }
+            }
+            begin = begin > t.capacity ? begin - t.capacity : 0;
+            end = end > t.capacity ? end - t.capacity : 0;
+        }
     }
 
     void saveKeysToStream(std::ostream& out) const {
-        for (size_t i = 0; i < capacity; ++i) {
-            if (table[i].isOccupied && !table[i].isDeleted) {
-                out << StringUtils::toStringValue<Key>(table[i].key) << "|";
+        for (const Table& t : ht) {
+            for (size_t i = 0; i < t.capacity; ++i) {
+                if (t.ctrl[i] >= 0) {
+                    out << StringUtils::toStringValue<Key>(t.slots[i].key) << "|";
+                }
             }
         }
     }
 
     void savePairsToStream(std::ostream& out) const {
-        for (size_t i = 0; i < capacity; ++i) {
-            if (table[i].isOccupied && !table[i].isDeleted) {
-                out << StringUtils::toStringValue<Key>(table[i].key) << ":"
-                    << StringUtils::toStringValue<Value>(table[i].value) << "|";
+        for (const Table& t : ht) {
+            for (size_t i = 0; i < t.capacity; ++i) {
+                if (t.ctrl[i] >= 0) {
+                    out << StringUtils::toStringValue<Key>(t.slots[i].key) << ":"
+                        << StringUtils::toStringValue<Value>(t.slots[i].value) << "|";
+                }
             }
         }
     }
 
  private:
-    struct Cell {
+    struct Slot {
         Key key;
         Value value;
-        bool isOccupied;
-        bool isDeleted;
+    };
 
-        Cell() : isOccupied(false), isDeleted(false) {}
+    // управляющие байты лежат отдельно от слотов: при пробировании
+    // ключи читаются только при совпадении 7-битного фрагмента хеша
+    struct Table {
+        int8_t* ctrl = nullptr;
+        Slot* slots = nullptr;
+        size_t capacity = 0;
+        size_t size = 0;
+        size_t deleted = 0;
     };
 
-    Cell* table;
-    size_t size;
-    size_t capacity;
-    float loadFactor;
+    // ht[0] - основная таблица, ht[1] - новая таблица во время рехеша
+    Table ht[2];
+    long rehashIdx;
 
-    int a, b;
-    int p;
+    // seed свой у каждой таблицы, копия наследует его вместе с раскладкой
+    uint64_t seed;
+    Hasher hasher;
 
-    void init() {
-        std::mt19937 gen(1337);
-        std::uniform_int_distribution<int> dist(1, 1000);
-        a = dist(gen);
-        b = dist(gen);
+    // хеш без привязки к емкости, считается один раз на операцию
+    size_t hash(KeyView key) const {
+        return hashKey<Key>(hasher, key, seed);
     }
 
-    size_t h1(const Key& key) const {
-        uint64_t keyValue = 0;
+    // емкость - степень двойки, кратная ширине группы
+    static size_t roundCapacity(int capacity) {
+        size_t cap = HT_MIN_CAPACITY;
+        while (capacity > 0 && cap < static_cast<size_t>(capacity)) {
+            cap <<= 1;
+        }
+        return cap;
+    }
 
-        if constexpr (std::is_integral_v<Key>
-                   || std::is_floating_point_v<Key>) {
-            keyValue = static_cast<uint64_t>(key);
+    static int8_t fragment(size_t h) {
+        return static_cast<int8_t>(h & 0x7F);
+    }
+
+    static size_t groupMask(const Table& t) {
+        return t.capacity / GROUP_WIDTH - 1;
+    }
+
+    static void allocate(Table& t, size_t capacity) {
+        t.ctrl = new int8_t[capacity];
+        t.slots = new Slot[capacity];
+        t.capacity = capacity;
+        t.size = 0;
+        t.deleted = 0;
+        for (size_t i = 0; i < capacity; i++) {
+            t.ctrl[i] = CTRL_EMPTY;
+        }
+    }
+
+    static void release(Table& t) {
+        delete[] t.ctrl;
+        delete[] t.slots;
+        t = Table();
+    }
+
+    static void copyTable(Table& dst, const Table& src) {
+        dst = Table();
+        if (!src.ctrl) {
+            return;
+        }
+
+        allocate(dst, src.capacity);
+        for (size_t i = 0; i < src.capacity; i++) {
+            dst.ctrl[i] = src.ctrl[i];
+            if (src.ctrl[i] >= 0) {
+                dst.slots[i] = src.slots[i];
+            }
+        }
+        dst.size = src.size;
+        dst.deleted = src.deleted;
+    }
+
+    // пробирование идет группами по 16 ячеек с треугольным шагом
+    static Slot* lookup(const Table& t, KeyView key, size_t h) {
+        if (t.capacity == 0) {
+            return nullptr;
+        }
+
+        size_t mask = groupMask(t);
+        size_t group = (h >> 7) & mask;
+        int8_t h2 = fragment(h);
+
+        for (size_t i = 0; i <= mask; i++) {
+            size_t base = group * GROUP_WIDTH;
+            ControlGroup g(t.ctrl + base);
+
+            for (uint32_t m = g.match(h2); m; m &= m - 1) {
+                Slot& slot = t.slots[base + ControlGroup::lowestBit(m)];
+                if (slot.key == key) {
+                    return &slot;
+                }
+            }
+
+            if (g.matchEmpty()) {
+                return nullptr;
+            }
+            group = (group + i + 1) & mask;
+        }
+
+        return nullptr;
+    }
+
+    template <typename K, typename V>
+    bool insertHashed(K&& key, V&& value, size_t h) {
+        rehashStep();
+        expandIfNeeded();
+
+        // во время рехеша ключ может еще лежать в старой таблице
+        if (isRehashing()) {
+            Slot* slot = lookup(ht[0], key, h);
+            if (slot) {
+                slot->value = std::forward<V>(value);
+                return true;
+            }
+        }
+
+        Table& target = isRehashing() ? ht[1] : ht[0];
+        Slot* slot = lookup(target, key, h);
+        if (slot) {
+            slot->value = std::forward<V>(value);
+            return true;
+        }
+
+        place(target, std::forward<K>(key), std::forward<V>(value), h);
+        return true;
+    }
+
+    static uint64_t reverseBits(uint64_t v) {
+        v = ((v >> 1) & 0x5555555555555555ull) | ((v & 0x5555555555555555ull) << 1);
+        v = ((v >> 2) & 0x3333333333333333ull) | ((v & 0x3333333333333333ull) << 2);
+        v = ((v >> 4) & 0x0F0F0F0F0F0F0F0Full) | ((v & 0x0F0F0F0F0F0F0F0Full) << 4);
+        v = ((v >> 8) & 0x00FF00FF00FF00FFull) | ((v & 0x00FF00FF00FF00FFull) << 8);
+        v = ((v >> 16) & 0x0000FFFF0000FFFFull) | ((v & 0x0000FFFF0000FFFFull) << 16);
+        return (v >> 32) | (v << 32);
+    }
+
+    // увеличение старших бит курсора, не покрытых маской
+    static uint64_t nextCursor(uint64_t v, uint64_t mask) {
+        v |= ~mask;
+        v = reverseBits(v);
+        v++;
+        return reverseBits(v);
+    }
+
+    // один шаг как в dictScan из Redis: группа меньшей таблицы
+    // и все группы большей, в которые она раскрывается
+    template <typename Fn>
+    uint64_t scanStep(uint64_t v, size_t& emitted, Fn& fn) const {
+        const Table* small = &ht[0];
+        const Table* large = isRehashing() ? &ht[1] : nullptr;
+        if (large && large->capacity < small->capacity) {
+            std::swap(small, large);
+        }
+        if (small->capacity == 0) {
+            // пустая таблица после перемещения
+            if (!large) {
+                return 0;
+            }
+            small = large;
+            large = nullptr;
+        }
+
+        uint64_t m0 = groupMask(*small);
+        emitted += emitGroup(*small, v & m0, fn);
+        if (!large) {
+            return nextCursor(v, m0);
+        }
+
+        uint64_t m1 = groupMask(*large);
+        do {
+            emitted += emitGroup(*large, v & m1, fn);
+            v = nextCursor(v, m1);
+        } while (v & (m0 ^ m1));
+        return v;
+    }
+
+    // элементы с домашней группой home лежат на ее цепочке проб
+    // до первой группы с пустой ячейкой
+    template <typename Fn>
+    size_t emitGroup(const Table& t, size_t home, Fn& fn) const {
+        size_t mask = groupMask(t);
+        size_t group = home;
+        size_t emitted = 0;
+
+        for (size_t i = 0; i <= mask; i++) {
+            size_t base = group * GROUP_WIDTH;
+            ControlGroup g(t.ctrl + base);
+
+            for (uint32_t m = g.matchFull(); m; m &= m - 1) {
+                const Slot& slot = t.slots[base + ControlGroup::lowestBit(m)];
+                if (((hash(slot.key) >> 7) & mask) == home) {
+                    fn(slot.key, slot.value);
+                    emitted++;
+                }
+            }
+
+            if (g.matchEmpty()) {
+                break;
+            }
+            group = (group + i + 1) & mask;
+        }
+        return emitted;
+    }
+
+    // сколько групп просматривает поиск ключа из ячейки index
+    size_t probeLength(const Table& t, size_t index) const {
+        size_t mask = groupMask(t);
+        size_t group = (hash(t.slots[index].key) >> 7) & mask;
+        size_t target = index / GROUP_WIDTH;
+
+        size_t probe = 1;
+        for (size_t i = 0; group != target && i <= mask; i++) {
+            group = (group + i + 1) & mask;
+            probe++;
+        }
+        return probe;
+    }
+
+    // вставка ключа, которого точно нет в таблице
+    template <typename K, typename V>
+    static Slot* place(Table& t, K&& key, V&& value, size_t h) {
+        size_t mask = groupMask(t);
+        size_t group = (h >> 7) & mask;
+
+        for (size_t i = 0; i <= mask; i++) {
+            size_t base = group * GROUP_WIDTH;
+            uint32_t free = ControlGroup(t.ctrl + base).matchEmptyOrDeleted();
+
+            if (free) {
+                size_t index = base + ControlGroup::lowestBit(free);
+                if (t.ctrl[index] == CTRL_DELETED) {
+                    t.deleted--;
+                }
+                t.ctrl[index] = fragment(h);
+                t.slots[index].key = std::forward<K>(key);
+                t.slots[index].value = std::forward<V>(value);
+                t.size++;
+                return &t.slots[index];
+            }
+            group = (group + i + 1) & mask;
+        }
+        return nullptr;
+    }
+
+    static bool erase(Table& t, KeyView key, size_t h) {
+        Slot* slot = lookup(t, key, h);
+        if (!slot) {
+            return false;
+        }
+
+        // если в группе уже есть пустая ячейка, то ни одна цепочка проб
+        // через эту группу не проходит и надгробие не нужно
+        size_t index = static_cast<size_t>(slot - t.slots);
+        size_t base = index - index % GROUP_WIDTH;
+        if (ControlGroup(t.ctrl + base).matchEmpty()) {
+            t.ctrl[index] = CTRL_EMPTY;
         } else {
-            for (char c : key) {
-                keyValue = keyValue * 131 + static_cast<unsigned char>(c);
+            t.ctrl[index] = CTRL_DELETED;
+            t.deleted++;
+        }
+        t.size--;
+
+        // память ключа и значения отдается сразу, а не когда ячейку
+        // займут снова: значением может быть целая структура
+        Slot released{};
+        std::swap(*slot, released);
+        return true;
+    }
+
+    static bool needsGrowth(const Table& t) {
+        return static_cast<float>(t.size + t.deleted + 1)
+            > t.capacity * HT_MAX_LOAD_FACTOR;
+    }
+
+    void expandIfNeeded() {
+        if (isRehashing()) {
+            // шаг рехеша не успел за вставками - доводим его до конца
+            if (!needsGrowth(ht[1])) {
+                return;
+            }
+            while (isRehashing()) {
+                rehashStep();
+            }
+        }
+
+        if (!needsGrowth(ht[0])) {
+            return;
+        }
+
+        // если порог превышен в основном за счет надгробий,
+        // достаточно перестроить таблицу того же размера
+        bool mostlyLive = static_cast<float>(ht[0].size * 2)
+            >= ht[0].capacity * HT_MAX_LOAD_FACTOR;
+        startRehash(mostlyLive ? ht[0].capacity * 2 : ht[0].capacity);
+    }
+
+    void compactIfNeeded() {
+        if (!isRehashing() && static_cast<float>(ht[0].deleted)
+                > ht[0].capacity * HT_MAX_TOMBSTONE_RATIO) {
+            startRehash(ht[0].capacity);
+        }
+    }
+
+    // перенос в новую таблицу идет постепенно, надгробия при этом пропадают
+    void startRehash(size_t capacity) {
+        allocate(ht[1], capacity < HT_MIN_CAPACITY ? HT_MIN_CAPACITY : capacity);
+        rehashIdx = 0;
+    }
+
+    // перенос очередной группы ячеек из ht[0] в ht[1]
+    void rehashStep() {
+        if (!isRehashing()) {
+            return;
+        }
+
+        size_t end = static_cast<size_t>(rehashIdx) + HT_REHASH_STEP;
+        if (end > ht[0].capacity) {
+            end = ht[0].capacity;
+        }
+
+        for (size_t i = static_cast<size_t>(rehashIdx); i < end; i++) {
+            if (ht[0].ctrl[i] >= 0) {
+                Slot& slot = ht[0].slots[i];
+                size_t h = hash(slot.key);
+                place(ht[1], std::move(slot.key), std::move(slot.value), h);
+                // помечаем как удаленную, чтобы не рвать цепочки проб
+                ht[0].ctrl[i] = CTRL_DELETED;
+                ht[0].size--;
             }
         }
+        rehashIdx = static_cast<long>(end);
 
-        return static_cast<size_t>(((a * keyValue + b) % p) % capacity);
+        if (end == ht[0].capacity) {
+            release(ht[0]);
+            ht[0] = ht[1];
+            ht[1] = Table();
+            rehashIdx = -1;
+        }
+    }
+
+    void printTable(const Table& t) const {
+        for (size_t i = 0; i < t.capacity; i++) {
+            std::cout << "[" << i << "]";
+            if (t.ctrl[i] >= 0) {
+                std::cout << " {" << t.slots[i].key
+                    << ": " << t.slots[i].value << "}";
+            } else if (t.ctrl[i] == CTRL_DELETED) {
+                std::cout << "(deleted)";
+            }
+            std::cout << std::endl;
+        }
     }
 
     void swap(HashTableOA& other) noexcept {
-        std::swap(table, other.table);
-        std::swap(loadFactor, other.loadFactor);
-        std::swap(size, other.size);
-        std::swap(capacity, other.capacity);
-
-        std::swap(a, other.a);
-        std::swap(b, other.b);
-        std::swap(p, other.p);
+        std::swap(ht[0], other.ht[0]);
+        std::swap(ht[1], other.ht[1]);
+        std::swap(rehashIdx, other.rehashIdx);
+
+        std::swap(seed, other.seed);
     }
 };
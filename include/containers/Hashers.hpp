@@ -0,0 +1,224 @@
+// Copyright message
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <string_view>
+
+// хешеры для HashTableOA: принимают байты или машинное слово и seed,
+// возвращают 64-битный хеш (младшие 7 бит идут в управляющий байт)
+
+namespace hashing {
+
+inline uint64_t read64(const unsigned char* p) {
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint64_t read32(const unsigned char* p) {
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint64_t rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+inline uint64_t splitmix64(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+// seed для очередной таблицы: случайная база процесса + счетчик,
+// чтобы не дергать std::random_device на каждую таблицу
+inline uint64_t randomSeed() {
+    static const uint64_t base =
+        (static_cast<uint64_t>(std::random_device{}()) << 32)
+        ^ std::random_device{}();
+    static std::atomic<uint64_t> counter{0};
+    return splitmix64(base + counter.fetch_add(1, std::memory_order_relaxed));
+}
+
+}  // namespace hashing
+
+// побайтовый полином, как в первой версии таблицы; оставлен для сравнения
+struct PolyHasher {
+    uint64_t operator()(std::string_view bytes, uint64_t seed) const {
+        uint64_t h = 0;
+        for (char c : bytes) {
+            h = h * 131 + static_cast<unsigned char>(c);
+        }
+        return (*this)(h, seed);
+    }
+
+    uint64_t operator()(uint64_t word, uint64_t seed) const {
+        uint64_t a = (seed & 0x3FF) + 1;
+        uint64_t b = ((seed >> 10) & 0x3FF) + 1;
+        return (a * word + b) % 1000000007;
+    }
+};
+
+// wyhash: 128-битное умножение со сверткой, по 8-16 байт за шаг
+struct WyHasher {
+    uint64_t operator()(std::string_view bytes, uint64_t seed) const {
+        const unsigned char* p =
+            reinterpret_cast<const unsigned char*>(bytes.data());
+        size_t len = bytes.size();
+        uint64_t a, b;
+
+        seed ^= mix(seed ^ S0, S1);
+        if (len <= 16) {
+            if (len >= 4) {
+                size_t shift = (len >> 3) << 2;
+                a = (hashing::read32(p) << 32) | hashing::read32(p + shift);
+                b = (hashing::read32(p + len - 4) << 32)
+                    | hashing::read32(p + len - 4 - shift);
+            } else if (len > 0) {
+                a = (static_cast<uint64_t>(p[0]) << 16)
+                    | (static_cast<uint64_t>(p[len >> 1]) << 8) | p[len - 1];
+                b = 0;
+            } else {
+                a = b = 0;
+            }
+        } else {
+            size_t i = len;
+            if (i > 48) {
+                uint64_t see1 = seed, see2 = seed;
+                do {
+                    seed = mix(hashing::read64(p) ^ S1, hashing::read64(p + 8) ^ seed);
+                    see1 = mix(hashing::read64(p + 16) ^ S2, hashing::read64(p + 24) ^ see1);
+                    see2 = mix(hashing::read64(p + 32) ^ S3, hashing::read64(p + 40) ^ see2);
+                    p += 48;
+                    i -= 48;
+                } while (i > 48);
+                seed ^= see1 ^ see2;
+            }
+            while (i > 16) {
+                seed = mix(hashing::read64(p) ^ S1, hashing::read64(p + 8) ^ seed);
+                i -= 16;
+                p += 16;
+            }
+            a = hashing::read64(p + i - 16);
+            b = hashing::read64(p + i - 8);
+        }
+
+        a ^= S1;
+        b ^= seed;
+        mum(a, b);
+        return mix(a ^ S0 ^ len, b ^ S1);
+    }
+
+    uint64_t operator()(uint64_t word, uint64_t seed) const {
+        uint64_t a = word ^ S0;
+        uint64_t b = seed ^ S1;
+        mum(a, b);
+        return mix(a ^ S0, b ^ S1);
+    }
+
+ private:
+    static constexpr uint64_t S0 = 0x2d358dccaa6c78a5ull;
+    static constexpr uint64_t S1 = 0x8bb84b93962eacc9ull;
+    static constexpr uint64_t S2 = 0x4b33a62ed433d4a3ull;
+    static constexpr uint64_t S3 = 0x4d5a2da51de1aa47ull;
+
+    static void mum(uint64_t& a, uint64_t& b) {
+        __uint128_t r = static_cast<__uint128_t>(a) * b;
+        a = static_cast<uint64_t>(r);
+        b = static_cast<uint64_t>(r >> 64);
+    }
+
+    static uint64_t mix(uint64_t a, uint64_t b) {
+        mum(a, b);
+        return a ^ b;
+    }
+};
+
+// xxh64: четыре независимые полосы по 8 байт для длинных ключей
+struct XxHasher {
+    uint64_t operator()(std::string_view bytes, uint64_t seed) const {
+        const unsigned char* p =
+            reinterpret_cast<const unsigned char*>(bytes.data());
+        const unsigned char* end = p + bytes.size();
+        uint64_t h;
+
+        if (bytes.size() >= 32) {
+            uint64_t v1 = seed + P1 + P2;
+            uint64_t v2 = seed + P2;
+            uint64_t v3 = seed;
+            uint64_t v4 = seed - P1;
+            do {
+                v1 = round(v1, hashing::read64(p));
+                v2 = round(v2, hashing::read64(p + 8));
+                v3 = round(v3, hashing::read64(p + 16));
+                v4 = round(v4, hashing::read64(p + 24));
+                p += 32;
+            } while (end - p >= 32);
+
+            h = hashing::rotl(v1, 1) + hashing::rotl(v2, 7)
+                + hashing::rotl(v3, 12) + hashing::rotl(v4, 18);
+            h = merge(h, v1);
+            h = merge(h, v2);
+            h = merge(h, v3);
+            h = merge(h, v4);
+        } else {
+            h = seed + P5;
+        }
+
+        h += bytes.size();
+        while (end - p >= 8) {
+            h ^= round(0, hashing::read64(p));
+            h = hashing::rotl(h, 27) * P1 + P4;
+            p += 8;
+        }
+        if (end - p >= 4) {
+            h ^= hashing::read32(p) * P1;
+            h = hashing::rotl(h, 23) * P2 + P3;
+            p += 4;
+        }
+        while (p < end) {
+            h ^= *p * P5;
+            h = hashing::rotl(h, 11) * P1;
+            ++p;
+        }
+
+        return avalanche(h);
+    }
+
+    uint64_t operator()(uint64_t word, uint64_t seed) const {
+        uint64_t h = seed + P5 + 8;
+        h ^= round(0, word);
+        h = hashing::rotl(h, 27) * P1 + P4;
+        return avalanche(h);
+    }
+
+ private:
+    static constexpr uint64_t P1 = 11400714785074694791ull;
+    static constexpr uint64_t P2 = 14029467366897019727ull;
+    static constexpr uint64_t P3 = 1609587929392839161ull;
+    static constexpr uint64_t P4 = 9650029242287828579ull;
+    static constexpr uint64_t P5 = 2870177450012600261ull;
+
+    static uint64_t round(uint64_t acc, uint64_t input) {
+        acc += input * P2;
+        return hashing::rotl(acc, 31) * P1;
+    }
+
+    static uint64_t merge(uint64_t acc, uint64_t val) {
+        acc ^= round(0, val);
+        return acc * P1 + P4;
+    }
+
+    static uint64_t avalanche(uint64_t h) {
+        h ^= h >> 33;
+        h *= P2;
+        h ^= h >> 29;
+        h *= P3;
+        return h ^ (h >> 32);
+    }
+};
@@ -0,0 +1,474 @@
+// Copyright message
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include "./HashTableOA.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// множество int. Пока элементов немного - отсортированный плотный массив
+// с двоичным поиском. Большое множество переходит либо в roaring-подобную
+// схему (старшие 16 бит выбирают контейнер, младшие хранятся в нем
+// отсортированным массивом uint16 до 4096 штук или битовой картой на
+// 65536 бит), либо, если значения сильно разрежены и контейнеры вышли бы
+// почти пустыми, в обычную HashTableOA<int, bool>.
+// Используется Set<int> вместо CompactTable<int, bool>, поэтому повторяет
+// его интерфейс (bool-значение в insert и обходах ничего не несет)
+class IntSet {
+ public:
+    // после этого размера плотный массив меняет представление
+    static inline size_t maxSortedSize = 4096;
+    // roaring выбирается, если в среднем на контейнер приходится
+    // не меньше стольких элементов
+    static inline size_t minContainerFill = 16;
+
+    IntSet() = default;
+
+    explicit IntSet(int capacity) {
+        if (capacity > 0 && static_cast<size_t>(capacity) <= maxSortedSize) {
+            sorted.reserve(capacity);
+        }
+    }
+
+    IntSet(const IntSet& other)
+        : encoding(other.encoding),
+          sorted(other.sorted),
+          count(other.count),
+          table(other.table ? std::make_unique<Table>(*other.table) : nullptr) {
+        for (const Container& c : other.containers) {
+            containers.push_back(c.clone());
+        }
+    }
+
+    IntSet(IntSet&&) noexcept = default;
+
+    IntSet& operator=(const IntSet& other) {
+        if (this != &other) {
+            IntSet tmp(other);
+            *this = std::move(tmp);
+        }
+        return *this;
+    }
+
+    IntSet& operator=(IntSet&&) noexcept = default;
+
+    bool insert(int value, bool = true) {
+        if (encoding == Encoding::Hash) {
+            return table->insert(value, true);
+        }
+
+        if (encoding == Encoding::Sorted) {
+            auto it = std::lower_bound(sorted.begin(), sorted.end(), value);
+            if (it == sorted.end() || *it != value) {
+                sorted.insert(it, value);
+                count++;
+                if (sorted.size() > maxSortedSize) {
+                    convert();
+                }
+            }
+            return true;
+        }
+
+        uint32_t u = toUnsigned(value);
+        Container& c = containerFor(static_cast<uint16_t>(u >> 16));
+        if (c.add(static_cast<uint16_t>(u))) {
+            count++;
+        }
+        return true;
+    }
+
+    bool remove(int value) {
+        if (encoding == Encoding::Hash) {
+            return table->remove(value);
+        }
+
+        if (encoding == Encoding::Sorted) {
+            auto it = std::lower_bound(sorted.begin(), sorted.end(), value);
+            if (it == sorted.end() || *it != value) {
+                return false;
+            }
+            sorted.erase(it);
+            count--;
+            return true;
+        }
+
+        uint32_t u = toUnsigned(value);
+        size_t index = findContainer(static_cast<uint16_t>(u >> 16));
+        if (index == NOT_FOUND || !containers[index].erase(static_cast<uint16_t>(u))) {
+            return false;
+        }
+        if (containers[index].cardinality == 0) {
+            containers.erase(containers.begin() + index);
+        }
+        count--;
+        return true;
+    }
+
+    bool isPresent(int value) const {
+        if (encoding == Encoding::Hash) {
+            return table->isPresent(value);
+        }
+
+        if (encoding == Encoding::Sorted) {
+            return sortedContains(sorted.data(), sorted.size(), value);
+        }
+
+        uint32_t u = toUnsigned(value);
+        size_t index = findContainer(static_cast<uint16_t>(u >> 16));
+        return index != NOT_FOUND && containers[index].contains(static_cast<uint16_t>(u));
+    }
+
+    size_t getSize() const {
+        return encoding == Encoding::Hash ? table->getSize() : count;
+    }
+
+    template <typename Fn>
+    void forEach(Fn&& fn) const {
+        forEachPartition(0, 1, fn);
+    }
+
+    // части делятся по индексам массива, по контейнерам или по ячейкам таблицы
+    template <typename Fn>
+    void forEachPartition(size_t part, size_t parts, Fn&& fn) const {
+        if (encoding == Encoding::Hash) {
+            size_t chunk = (table->slotCount() + parts - 1) / parts;
+            table->forEachInRange(part * chunk, (part + 1) * chunk, fn);
+            return;
+        }
+
+        size_t total = encoding == Encoding::Roaring ? containers.size() : sorted.size();
+        size_t chunk = (total + parts - 1) / parts;
+        size_t begin = std::min(total, part * chunk);
+        size_t end = std::min(total, begin + chunk);
+
+        for (size_t i = begin; i < end; ++i) {
+            if (encoding == Encoding::Sorted) {
+                fn(sorted[i], true);
+            } else {
+                containers[i].forEach(fn);
+            }
+        }
+    }
+
+    // в массиве и roaring курсор - следующее значение в беззнаковом порядке
+    // плюс один с флагом VALUE_CURSOR; в хеш-таблице - курсор HashTableOA.
+    // Значение-курсор, пришедший после перехода в хеш-таблицу, начинает ее
+    // обход заново: повторы допустимы, пропусков нет
+    template <typename Fn>
+    uint64_t scan(uint64_t cursor, size_t limit, Fn&& fn) const {
+        if (encoding == Encoding::Hash) {
+            return table->scan(cursor & VALUE_CURSOR ? 0 : cursor, limit, fn);
+        }
+
+        uint64_t next = cursor == 0 ? 0 : (cursor & ~VALUE_CURSOR) - 1;
+        size_t emitted = 0;
+        uint64_t last = 0;
+
+        auto emit = [&](int value, bool) {
+            uint64_t u = toUnsigned(value);
+            if (u < next || emitted >= limit) {
+                return;
+            }
+            fn(value, true);
+            emitted++;
+            last = u;
+        };
+
+        if (encoding == Encoding::Sorted) {
+            auto it = std::lower_bound(sorted.begin(), sorted.end(), next,
+                [](int value, uint64_t u) { return toUnsigned(value) < u; });
+            for (; it != sorted.end() && emitted < limit; ++it) {
+                emit(*it, true);
+            }
+        } else {
+            auto it = std::lower_bound(containers.begin(), containers.end(), next >> 16,
+                [](const Container& c, uint64_t key) { return c.key < key; });
+            for (; it != containers.end() && emitted < limit; ++it) {
+                it->forEach(emit);
+            }
+        }
+
+        if (emitted < limit || last == UINT32_MAX) {
+            return 0;
+        }
+        return (last + 2) | VALUE_CURSOR;
+    }
+
+    TableStats getStats() const {
+        if (encoding == Encoding::Hash) {
+            TableStats stats = table->getStats();
+            stats.bytes += sizeof(*this);
+            return stats;
+        }
+
+        TableStats stats;
+        stats.encoding = encoding == Encoding::Roaring ? "roaring" : "intset";
+        stats.size = count;
+        stats.bytes = sizeof(*this);
+        if (encoding == Encoding::Sorted) {
+            stats.capacity = sorted.capacity();
+            stats.bytes += sorted.capacity() * sizeof(int);
+        } else {
+            stats.capacity = containers.size();
+            stats.bytes += containers.capacity() * sizeof(Container);
+            for (const Container& c : containers) {
+                stats.bytes += c.bytes();
+            }
+        }
+        if (stats.capacity > 0) {
+            stats.loadFactor = static_cast<float>(stats.size) / stats.capacity;
+        }
+        // двоичный поиск: число сравнений ~ log2(n)
+        size_t probe = 1;
+        size_t n = encoding == Encoding::Roaring ? maxArraySize : sorted.size();
+        for (; n > 1; n >>= 1) {
+            probe++;
+        }
+        stats.avgProbe = static_cast<double>(probe);
+        stats.maxProbe = probe;
+        return stats;
+    }
+
+    void print() const {
+        forEach([](int value, bool) { std::cout << value << " "; });
+        std::cout << std::endl;
+    }
+
+    void saveKeysToStream(std::ostream& out) const {
+        forEach([&out](int value, bool) { out << value << "|"; });
+    }
+
+ private:
+    using Table = HashTableOA<int, bool>;
+    enum class Encoding { Sorted, Roaring, Hash };
+
+    static constexpr size_t NOT_FOUND = static_cast<size_t>(-1);
+    static constexpr uint64_t VALUE_CURSOR = 1ull << 40;
+    // порог array -> bitmap внутри контейнера, как в roaring
+    static constexpr size_t maxArraySize = 4096;
+    static constexpr size_t bitmapWords = 65536 / 64;
+
+    // контейнер для 65536 значений с одинаковыми старшими 16 битами
+    struct Container {
+        uint16_t key = 0;
+        uint32_t cardinality = 0;
+        std::vector<uint16_t> array;
+        std::unique_ptr<uint64_t[]> bitmap;
+
+        Container clone() const {
+            Container copy;
+            copy.key = key;
+            copy.cardinality = cardinality;
+            copy.array = array;
+            if (bitmap) {
+                copy.bitmap.reset(new uint64_t[bitmapWords]);
+                std::copy(bitmap.get(), bitmap.get() + bitmapWords, copy.bitmap.get());
+            }
+            return copy;
+        }
+
+        bool contains(uint16_t low) const {
+            if (bitmap) {
+                return (bitmap[low >> 6] >> (low & 63)) & 1;
+            }
+            return sortedContains(array.data(), array.size(), low);
+        }
+
+        bool add(uint16_t low) {
+            if (bitmap) {
+                uint64_t bit = 1ull << (low & 63);
+                if (bitmap[low >> 6] & bit) {
+                    return false;
+                }
+                bitmap[low >> 6] |= bit;
+                cardinality++;
+                return true;
+            }
+
+            auto it = std::lower_bound(array.begin(), array.end(), low);
+            if (it != array.end() && *it == low) {
+                return false;
+            }
+            array.insert(it, low);
+            cardinality++;
+            if (array.size() > maxArraySize) {
+                toBitmap();
+            }
+            return true;
+        }
+
+        bool erase(uint16_t low) {
+            if (bitmap) {
+                uint64_t bit = 1ull << (low & 63);
+                if (!(bitmap[low >> 6] & bit)) {
+                    return false;
+                }
+                bitmap[low >> 6] &= ~bit;
+                cardinality--;
+                if (cardinality <= maxArraySize) {
+                    toArray();
+                }
+                return true;
+            }
+
+            auto it = std::lower_bound(array.begin(), array.end(), low);
+            if (it == array.end() || *it != low) {
+                return false;
+            }
+            array.erase(it);
+            cardinality--;
+            return true;
+        }
+
+        template <typename Fn>
+        void forEach(Fn& fn) const {
+            uint32_t high = static_cast<uint32_t>(key) << 16;
+            if (!bitmap) {
+                for (uint16_t low : array) {
+                    fn(fromUnsigned(high | low), true);
+                }
+                return;
+            }
+
+            for (size_t w = 0; w < bitmapWords; ++w) {
+                for (uint64_t word = bitmap[w]; word; word &= word - 1) {
+                    uint32_t low = static_cast<uint32_t>(w * 64 + __builtin_ctzll(word));
+                    fn(fromUnsigned(high | low), true);
+                }
+            }
+        }
+
+        size_t bytes() const {
+            return bitmap ? bitmapWords * sizeof(uint64_t)
+                          : array.capacity() * sizeof(uint16_t);
+        }
+
+        void toBitmap() {
+            bitmap.reset(new uint64_t[bitmapWords]());
+            for (uint16_t low : array) {
+                bitmap[low >> 6] |= 1ull << (low & 63);
+            }
+            std::vector<uint16_t>().swap(array);
+        }
+
+        void toArray() {
+            array.reserve(cardinality);
+            forEachBit([this](uint16_t low) { array.push_back(low); });
+            bitmap.reset();
+        }
+
+        template <typename Fn>
+        void forEachBit(Fn fn) const {
+            for (size_t w = 0; w < bitmapWords; ++w) {
+                for (uint64_t word = bitmap[w]; word; word &= word - 1) {
+                    fn(static_cast<uint16_t>(w * 64 + __builtin_ctzll(word)));
+                }
+            }
+        }
+    };
+
+    Encoding encoding = Encoding::Sorted;
+    std::vector<int> sorted;
+    size_t count = 0;
+    std::vector<Container> containers;
+    std::unique_ptr<Table> table;
+
+    // сдвиг знака, чтобы беззнаковый порядок совпадал со знаковым
+    static uint32_t toUnsigned(int value) {
+        return static_cast<uint32_t>(value) ^ 0x80000000u;
+    }
+
+    static int fromUnsigned(uint32_t u) {
+        return static_cast<int>(u ^ 0x80000000u);
+    }
+
+    // двоичный поиск сужает диапазон до нескольких элементов,
+    // остаток сравнивается пачкой SSE2-инструкцией
+    template <typename V>
+    static bool sortedContains(const V* data, size_t size, V value) {
+        constexpr size_t lanes = 16 / sizeof(V);
+        size_t lo = 0;
+        size_t hi = size;
+        while (hi - lo > 2 * lanes) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (data[mid] < value) {
+                lo = mid + 1;
+            } else {
+                hi = mid + 1;  // data[mid] может оказаться искомым
+            }
+        }
+
+#if defined(__SSE2__)
+        for (; lo + lanes <= hi; lo += lanes) {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + lo));
+            __m128i eq;
+            if constexpr (sizeof(V) == 4) {
+                eq = _mm_cmpeq_epi32(block, _mm_set1_epi32(static_cast<int>(value)));
+            } else {
+                eq = _mm_cmpeq_epi16(block, _mm_set1_epi16(static_cast<int16_t>(value)));
+            }
+            if (_mm_movemask_epi8(eq)) {
+                return true;
+            }
+        }
+#endif
+        for (; lo < hi; ++lo) {
+            if (data[lo] == value) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    size_t findContainer(uint16_t key) const {
+        auto it = std::lower_bound(containers.begin(), containers.end(), key,
+            [](const Container& c, uint16_t k) { return c.key < k; });
+        if (it == containers.end() || it->key != key) {
+            return NOT_FOUND;
+        }
+        return static_cast<size_t>(it - containers.begin());
+    }
+
+    // контейнер с таким ключом, при отсутствии создается пустой
+    Container& containerFor(uint16_t key) {
+        auto it = std::lower_bound(containers.begin(), containers.end(), key,
+            [](const Container& c, uint16_t k) { return c.key < k; });
+        if (it == containers.end() || it->key != key) {
+            Container c;
+            c.key = key;
+            it = containers.insert(it, std::move(c));
+        }
+        return *it;
+    }
+
+    // выбор представления для переросшего массива по плотности значений
+    void convert() {
+        size_t highKeys = 0;
+        for (size_t i = 0; i < sorted.size(); ++i) {
+            if (i == 0 || (toUnsigned(sorted[i]) >> 16) != (toUnsigned(sorted[i - 1]) >> 16)) {
+                highKeys++;
+            }
+        }
+
+        if (sorted.size() >= highKeys * minContainerFill) {
+            for (int value : sorted) {
+                uint32_t u = toUnsigned(value);
+                containerFor(static_cast<uint16_t>(u >> 16)).add(static_cast<uint16_t>(u));
+            }
+            encoding = Encoding::Roaring;
+        } else {
+            table = std::make_unique<Table>(static_cast<int>(sorted.size() * 2));
+            for (int value : sorted) {
+                table->insert(value, true);
+            }
+            encoding = Encoding::Hash;
+        }
+        std::vector<int>().swap(sorted);
+    }
+};
@@ -1,78 +1,121 @@
 // Copyright message
 #pragma once
 
+#include <algorithm>
 #include <iostream>
+#include <iterator>
 #include <fstream>
+#include <memory>
+#include <new>
 #include <stdexcept>
 #include <string>
+#include <utility>
+#include <vector>
 #include "../utils/StringUtils.hpp"
 
+// размер блока очереди в байтах; число элементов в блоке округляется
+// вниз до степени двойки, чтобы позиция делилась на блок и смещение масками
+const size_t QUEUE_BLOCK_BYTES = 4096;
+// сколько опустевших блоков держится про запас для повторного использования
+const size_t QUEUE_SPARE_BLOCKS = 4;
+const size_t QUEUE_MIN_MAP = 8;
+
+// очередь на кольце блоков фиксированного размера: при росте добавляется
+// новый блок и, изредка, удваивается массив указателей на блоки, но сами
+// элементы никогда не переносятся. Блоки, из которых все извлечено,
+// уходят в небольшой запас или освобождаются, массив указателей
+// сжимается, когда очередь опустела
 template <typename T>
 class myQueue {
  public:
+    // начальная емкость лишь подсказывает размер массива блоков,
+    // сами блоки выделяются по мере вставки
     explicit myQueue(int initialCapacity = 4)
-        : data(nullptr), head(0), tail(0), size(0) {
-        if (initialCapacity <= 0) initialCapacity = 4;
-        capacity = initialCapacity;
-        data = new T[capacity];
-    }
+        : map(mapSizeFor(blocksFor(initialCapacity > 0 ? initialCapacity : 0)), nullptr),
+          first(0), used(0), headOffset(0), size(0) {}
 
     myQueue(const myQueue& other)
-        : data(new T[other.capacity]),
-          head(0),
-          tail(other.size),
-          size(other.size),
-          capacity(other.capacity) {
-        for (int i = 0; i < size; ++i) {
-            data[i] = other.data[(other.head + i) % other.capacity];
-        }
+        : map(mapSizeFor(other.used), nullptr),
+          first(0), used(0), headOffset(0), size(0) {
+        other.forEachRun(0, other.size, [this](const T* run, size_t count) {
+            pushRange(run, run + count);
+        });
+    }
+
+    myQueue(myQueue&& other) noexcept
+        : map(std::move(other.map)),
+          spare(std::move(other.spare)),
+          first(other.first),
+          used(other.used),
+          headOffset(other.headOffset),
+          size(other.size) {
+        other.map.clear();
+        other.spare.clear();
+        other.first = other.used = other.headOffset = other.size = 0;
     }
 
     myQueue& operator=(const myQueue& other) {
         if (this != &other) {
-            delete[] data;
+            myQueue tmp(other);
+            *this = std::move(tmp);
+        }
+        return *this;
+    }
 
-            capacity = other.capacity;
+    myQueue& operator=(myQueue&& other) noexcept {
+        if (this != &other) {
+            clean();
+            map = std::move(other.map);
+            spare = std::move(other.spare);
+            first = other.first;
+            used = other.used;
+            headOffset = other.headOffset;
             size = other.size;
-            head = 0;
-            tail = size;
-            data = new T[capacity];
 
-            for (int i = 0; i < size; ++i) {
-                data[i] = other.data[(other.head + i) % other.capacity];
-            }
+            other.map.clear();
+            other.spare.clear();
+            other.first = other.used = other.headOffset = other.size = 0;
         }
         return *this;
     }
 
-
     ~myQueue() {
         clean();
     }
 
     void clean() {
-        delete[] data;
-        data = nullptr;
-        head = tail = size = capacity = 0;
+        while (size > 0) {
+            pop();
+        }
+        // блоки, зарезервированные reserve() и еще не занятые
+        for (size_t i = 0; i < used; ++i) {
+            delete blockAt(i);
+        }
+        for (Block* block : spare) {
+            delete block;
+        }
+        spare.clear();
+        map.clear();
+        first = used = headOffset = 0;
     }
 
     void push(const T& value) {
-        if (size == capacity) {
-            int newCapacity = capacity * 2;
-            T* newData = new T[newCapacity];
-            for (int i = 0; i < size; ++i) {
-                newData[i] = data[(head + i) % capacity];
-            }
+        emplace(value);
+    }
 
-            delete[] data;
-            data = newData;
-            capacity = newCapacity;
-            head = 0;
-            tail = size;
+    void push(T&& value) {
+        emplace(std::move(value));
+    }
+
+    template <typename... Args>
+    void emplace(Args&&... args) {
+        size_t pos = headOffset + size;
+        if ((pos >> BLOCK_SHIFT) == used) {
+            addBlock();
         }
 
-        data[tail] = value;
-        tail = (tail + 1) % capacity;
+        new (blockAt(pos >> BLOCK_SHIFT)->slot(pos & BLOCK_MASK))
+            T(std::forward<Args>(args)...);
         size++;
     }
 
@@ -81,8 +124,77 @@ class myQueue {
             throw std::underflow_error("Queue is empty!");
         }
 
-        head = (head + 1) % capacity;
+        map[first]->slot(headOffset)->~T();
+        headOffset++;
         size--;
+        releaseDrained();
+    }
+
+    // резервирует блоки под n элементов, чтобы серия вставок не выделяла
+    // память по одному блоку
+    void reserve(int n) {
+        size_t needed = blocksFor(headOffset + static_cast<size_t>(std::max(n, 0)));
+        while (used < needed) {
+            addBlock();
+        }
+    }
+
+    // вставка пачки: в каждый блок копируется непрерывный кусок
+    template <typename It>
+    void pushRange(It begin, It end) {
+        while (begin != end) {
+            size_t pos = headOffset + size;
+            if ((pos >> BLOCK_SHIFT) == used) {
+                addBlock();
+            }
+
+            size_t offset = pos & BLOCK_MASK;
+            size_t run = std::min(BLOCK_ITEMS - offset,
+                                  static_cast<size_t>(std::distance(begin, end)));
+            std::uninitialized_copy_n(begin, run,
+                                      blockAt(pos >> BLOCK_SHIFT)->slot(offset));
+            std::advance(begin, run);
+            size += run;
+        }
+    }
+
+    // забирает до count элементов из головы в out, возвращает сколько забрано
+    size_t popInto(std::vector<T>& out, size_t count) {
+        count = std::min(count, size);
+        out.reserve(out.size() + count);
+        for (size_t left = count; left > 0;) {
+            size_t run = std::min(left, BLOCK_ITEMS - headOffset);
+            T* from = map[first]->slot(headOffset);
+            std::move(from, from + run, std::back_inserter(out));
+            std::destroy_n(from, run);
+            headOffset += run;
+            size -= run;
+            left -= run;
+            releaseDrained();
+        }
+        return count;
+    }
+
+    // копии элементов [start, start + count) от головы, без извлечения
+    void copyRange(size_t start, size_t count, std::vector<T>& out) const {
+        if (start >= size) {
+            return;
+        }
+        count = std::min(count, size - start);
+        out.reserve(out.size() + count);
+        forEachRun(start, count, [&out](const T* run, size_t n) {
+            out.insert(out.end(), run, run + n);
+        });
+    }
+
+    // от головы к хвосту
+    template <typename Fn>
+    void forEach(Fn&& fn) const {
+        forEachRun(0, size, [&fn](const T* run, size_t count) {
+            for (size_t i = 0; i < count; ++i) {
+                fn(run[i]);
+            }
+        });
     }
 
     void print() const {
@@ -91,9 +203,11 @@ class myQueue {
             return;
         }
 
-        for (int i = 0; i < size; ++i) {
-            std::cout << data[(head + i) % capacity] << " ";
-        }
+        forEachRun(0, size, [](const T* run, size_t count) {
+            for (size_t i = 0; i < count; ++i) {
+                std::cout << run[i] << " ";
+            }
+        });
         std::cout << std::endl;
     }
 
@@ -102,28 +216,163 @@ class myQueue {
             throw std::underflow_error("Queue is empty!");
         }
 
-        return data[head];
+        return *map[first]->slot(headOffset);
+    }
+
+    T& front() {
+        if (size == 0) {
+            throw std::underflow_error("Queue is empty!");
+        }
+
+        return *map[first]->slot(headOffset);
     }
 
-    int getSize() const {
+    size_t getSize() const {
         return size;
     }
 
-    int getCapacity() const {
-        return capacity;
+    // элементов помещается в уже выделенные блоки, без учета запаса
+    size_t getCapacity() const {
+        return used * BLOCK_ITEMS;
     }
 
     void saveElementsToStream(std::ostream& out) const {
-        for (int i = 0; i < size; ++i) {
-            int index = (head + i) % capacity;
-            out << StringUtils::toStringValue<T>(data[index]) << "|";
-        }
+        forEachRun(0, size, [&out](const T* run, size_t count) {
+            for (size_t i = 0; i < count; ++i) {
+                out << StringUtils::toStringValue<T>(run[i]) << "|";
+            }
+        });
     }
 
  private:
-    T* data;
-    int head;
-    int tail;
-    int size;
-    int capacity;
+    static constexpr size_t blockItems() {
+        size_t items = 1;
+        while (items * 2 * sizeof(T) <= QUEUE_BLOCK_BYTES) {
+            items *= 2;
+        }
+        return items;
+    }
+
+    static constexpr size_t blockShift() {
+        size_t shift = 0;
+        while ((size_t(1) << shift) < blockItems()) {
+            shift++;
+        }
+        return shift;
+    }
+
+    static constexpr size_t BLOCK_ITEMS = blockItems();
+    static constexpr size_t BLOCK_SHIFT = blockShift();
+    static constexpr size_t BLOCK_MASK = BLOCK_ITEMS - 1;
+
+    struct Block {
+        alignas(T) unsigned char storage[BLOCK_ITEMS * sizeof(T)];
+
+        T* slot(size_t i) {
+            return std::launder(reinterpret_cast<T*>(storage) + i);
+        }
+
+        const T* slot(size_t i) const {
+            return std::launder(reinterpret_cast<const T*>(storage) + i);
+        }
+    };
+
+    // кольцо указателей на блоки, размер - степень двойки;
+    // занятые блоки идут подряд начиная с first
+    std::vector<Block*> map;
+    std::vector<Block*> spare;
+    size_t first;
+    size_t used;        // занятых блоков в кольце
+    size_t headOffset;  // позиция головы внутри первого блока
+    size_t size;
+
+    static size_t blocksFor(size_t items) {
+        return (items + BLOCK_MASK) >> BLOCK_SHIFT;
+    }
+
+    static size_t mapSizeFor(size_t blocks) {
+        size_t mapSize = QUEUE_MIN_MAP;
+        while (mapSize < blocks) {
+            mapSize <<= 1;
+        }
+        return mapSize;
+    }
+
+    Block* blockAt(size_t index) const {
+        return map[(first + index) & (map.size() - 1)];
+    }
+
+    void addBlock() {
+        if (used == map.size()) {
+            resizeMap(mapSizeFor(used + 1));
+        }
+
+        Block* block;
+        if (!spare.empty()) {
+            block = spare.back();
+            spare.pop_back();
+        } else {
+            block = new Block;
+        }
+        map[(first + used) & (map.size() - 1)] = block;
+        used++;
+    }
+
+    // переносятся только указатели на блоки, элементы остаются на месте
+    void resizeMap(size_t mapSize) {
+        std::vector<Block*> resized(mapSize, nullptr);
+        for (size_t i = 0; i < used; ++i) {
+            resized[i] = blockAt(i);
+        }
+        map.swap(resized);
+        first = 0;
+    }
+
+    void recycle(Block* block) {
+        if (spare.size() < QUEUE_SPARE_BLOCKS) {
+            spare.push_back(block);
+        } else {
+            delete block;
+        }
+    }
+
+    void dropFirstBlock() {
+        recycle(map[first]);
+        map[first] = nullptr;
+        first = (first + 1) & (map.size() - 1);
+        used--;
+    }
+
+    // после извлечения: вычерпанный первый блок отдается в запас,
+    // опустевшая очередь отдает все блоки и начинает с начала,
+    // а слишком просторный массив указателей сжимается
+    void releaseDrained() {
+        if (size == 0) {
+            while (used > 0) {
+                dropFirstBlock();
+            }
+            first = 0;
+            headOffset = 0;
+        } else if (headOffset == BLOCK_ITEMS) {
+            dropFirstBlock();
+            headOffset = 0;
+        }
+
+        if (map.size() > QUEUE_MIN_MAP && used * 4 < map.size()) {
+            resizeMap(std::max(mapSizeFor(used), map.size() / 2));
+        }
+    }
+
+    // fn(указатель, длина) для непрерывных кусков [start, start + count)
+    template <typename Fn>
+    void forEachRun(size_t start, size_t count, Fn&& fn) const {
+        size_t pos = headOffset + start;
+        while (count > 0) {
+            size_t offset = pos & BLOCK_MASK;
+            size_t run = std::min(count, BLOCK_ITEMS - offset);
+            fn(static_cast<const Block*>(blockAt(pos >> BLOCK_SHIFT))->slot(offset), run);
+            pos += run;
+            count -= run;
+        }
+    }
 };
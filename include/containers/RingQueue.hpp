@@ -0,0 +1,256 @@
+// Copyright message
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+// очереди для передачи работы между потоками: ограниченное кольцо
+// емкостью в степень двойки, индекс ячейки - позиция & mask
+
+const size_t RING_CACHE_LINE = 64;
+
+inline size_t ringCapacity(size_t capacity) {
+    size_t cap = 2;
+    while (cap < capacity) {
+        cap <<= 1;
+    }
+    return cap;
+}
+
+// много писателей и много читателей без блокировок (схема Вьюкова):
+// у каждой ячейки свой номер последовательности, по нему поток понимает,
+// свободна ли ячейка на его круге, и захватывает позицию одним CAS
+template <typename T>
+class MpmcQueue {
+ public:
+    explicit MpmcQueue(size_t capacity)
+        : mask(ringCapacity(capacity) - 1),
+          cells(new Cell[mask + 1]) {
+        for (size_t i = 0; i <= mask; ++i) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpmcQueue(const MpmcQueue&) = delete;
+    MpmcQueue& operator=(const MpmcQueue&) = delete;
+
+    // false - очередь заполнена
+    template <typename U>
+    bool tryPush(U&& value) {
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &cells[pos & mask];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1,
+                                                     std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        cell->value = std::forward<U>(value);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // false - очередь пуста
+    bool tryPop(T& out) {
+        size_t pos = dequeuePos.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &cells[pos & mask];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeuePos.compare_exchange_weak(pos, pos + 1,
+                                                     std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        out = std::move(cell->value);
+        // ячейка освободится для писателя следующего круга
+        cell->sequence.store(pos + mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t capacity() const {
+        return mask + 1;
+    }
+
+    // при параллельной работе - лишь оценка
+    size_t sizeApprox() const {
+        size_t tail = enqueuePos.load(std::memory_order_relaxed);
+        size_t head = dequeuePos.load(std::memory_order_relaxed);
+        return tail > head ? tail - head : 0;
+    }
+
+ private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    const size_t mask;
+    std::unique_ptr<Cell[]> cells;
+    // позиции писателей и читателей на разных кэш-линиях
+    alignas(RING_CACHE_LINE) std::atomic<size_t> enqueuePos{0};
+    alignas(RING_CACHE_LINE) std::atomic<size_t> dequeuePos{0};
+};
+
+// ровно один писатель и один читатель: без CAS, каждая сторона пишет
+// только свой индекс и держит кэшированную копию чужого, чтобы реже
+// читать чужую кэш-линию
+template <typename T>
+class SpscQueue {
+ public:
+    explicit SpscQueue(size_t capacity)
+        : mask(ringCapacity(capacity) - 1),
+          slots(new T[mask + 1]) {}
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    template <typename U>
+    bool tryPush(U&& value) {
+        size_t tail = producer.index.load(std::memory_order_relaxed);
+        if (tail - producer.cached == mask + 1) {
+            producer.cached = consumer.index.load(std::memory_order_acquire);
+            if (tail - producer.cached == mask + 1) {
+                return false;
+            }
+        }
+
+        slots[tail & mask] = std::forward<U>(value);
+        producer.index.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool tryPop(T& out) {
+        size_t head = consumer.index.load(std::memory_order_relaxed);
+        if (head == consumer.cached) {
+            consumer.cached = producer.index.load(std::memory_order_acquire);
+            if (head == consumer.cached) {
+                return false;
+            }
+        }
+
+        out = std::move(slots[head & mask]);
+        consumer.index.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t capacity() const {
+        return mask + 1;
+    }
+
+    size_t sizeApprox() const {
+        return producer.index.load(std::memory_order_relaxed)
+            - consumer.index.load(std::memory_order_relaxed);
+    }
+
+ private:
+    // свой индекс и копия чужого
+    struct alignas(RING_CACHE_LINE) Side {
+        std::atomic<size_t> index{0};
+        size_t cached = 0;
+    };
+
+    const size_t mask;
+    std::unique_ptr<T[]> slots;
+    Side producer;
+    Side consumer;
+};
+
+// кольцо с блокирующим извлечением: пока элементы есть, работает
+// без блокировок; пустая очередь недолго опрашивается, а затем читатель
+// засыпает на condition_variable. Писатель трогает мьютекс, только
+// если кто-то действительно спит
+template <typename T, typename Ring = MpmcQueue<T>>
+class BlockingQueue {
+ public:
+    // сколько раз проверить очередь перед тем, как уснуть
+    static constexpr int SPIN_TRIES = 64;
+
+    explicit BlockingQueue(size_t capacity) : ring(capacity) {}
+
+    template <typename U>
+    bool tryPush(U&& value) {
+        if (!ring.tryPush(std::forward<U>(value))) {
+            return false;
+        }
+
+        // барьер в паре с барьером в popWait: либо писатель увидит
+        // ждущего, либо ждущий увидит элемент
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters.load(std::memory_order_relaxed) > 0) {
+            std::lock_guard<std::mutex> lock(mutex);
+            ready.notify_one();
+        }
+        return true;
+    }
+
+    bool tryPop(T& out) {
+        return ring.tryPop(out);
+    }
+
+    // ждет элемент не дольше timeout; false - время вышло
+    template <typename Rep, typename Period>
+    bool popWait(T& out, std::chrono::duration<Rep, Period> timeout) {
+        for (int i = 0; i < SPIN_TRIES; ++i) {
+            if (ring.tryPop(out)) {
+                return true;
+            }
+            std::this_thread::yield();
+        }
+
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        std::unique_lock<std::mutex> lock(mutex);
+        waiters.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        bool popped;
+        while (!(popped = ring.tryPop(out))) {
+            if (ready.wait_until(lock, deadline) == std::cv_status::timeout) {
+                popped = ring.tryPop(out);
+                break;
+            }
+        }
+
+        waiters.fetch_sub(1, std::memory_order_relaxed);
+        return popped;
+    }
+
+    size_t capacity() const {
+        return ring.capacity();
+    }
+
+    size_t sizeApprox() const {
+        return ring.sizeApprox();
+    }
+
+ private:
+    Ring ring;
+    alignas(RING_CACHE_LINE) std::atomic<int> waiters{0};
+    std::mutex mutex;
+    std::condition_variable ready;
+};
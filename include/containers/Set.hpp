@@ -1,36 +1,129 @@
 // Copyright
 #pragma once
 
+#include <atomic>
 #include <string>
 #include <iostream>
 #include <fstream>
 #include <sstream>
-#include "../containers/HashTableOA.hpp"
+#include <optional>
+#include <utility>
+#include <type_traits>
+#include "../containers/BloomFilter.hpp"
+#include "../containers/CompactTable.hpp"
+#include "../containers/IntSet.hpp"
 #include "../utils/StringUtils.hpp"
 
 template <typename T>
 class Set {
  public:
-    Set() : table(1000) {}
+    Set() = default;
 
     explicit Set(int capacity) : table(capacity) {}
 
     bool insert(const T& value) {
+        addToFilter(value);
         return table.insert(value, true);
     }
 
+    bool insert(T&& value) {
+        addToFilter(value);
+        return table.insert(std::move(value), true);
+    }
+
+    // элемент строится из args прямо при вставке
+    template <typename... Args>
+    bool emplace(Args&&... args) {
+        return insert(T(std::forward<Args>(args)...));
+    }
+
     bool remove(const T& value) {
-        return table.remove(value);
+        if (!table.remove(value)) {
+            return false;
+        }
+        if (bloom) {
+            bloom->noteRemoval();
+            rebuildFilterIfNeeded(size());
+        }
+        return true;
     }
 
+    // при включенном фильтре отрицательный ответ обходится без таблицы
     bool contains(const T& value) const {
-        return table.isPresent(value);
+        if (!bloom) {
+            return table.isPresent(value);
+        }
+
+        bloomChecks.increment();
+        if (!bloom->mayContain(value)) {
+            bloomNegatives.increment();
+            return false;
+        }
+        bool found = table.isPresent(value);
+        if (!found) {
+            bloomFalsePositives.increment();
+        }
+        return found;
+    }
+
+    // фильтр Блума перед таблицей, fpr - целевая доля ложных срабатываний
+    void enableFilter(double fpr) {
+        bloom.emplace(fpr, size());
+        forEach([this](const T& value) { bloom->add(value); });
+        bloomChecks.reset();
+        bloomNegatives.reset();
+        bloomFalsePositives.reset();
+    }
+
+    void disableFilter() {
+        bloom.reset();
+    }
+
+    bool hasFilter() const {
+        return bloom.has_value();
+    }
+
+    BloomStats filterStats() const {
+        if (!bloom) {
+            return BloomStats();
+        }
+        BloomStats stats = bloom->getStats();
+        stats.checks = bloomChecks.load();
+        stats.negatives = bloomNegatives.load();
+        stats.falsePositives = bloomFalsePositives.load();
+        return stats;
     }
 
     size_t size() const {
         return table.getSize();
     }
 
+    // fn(const T&) для очередной порции элементов, см. HashTableOA::scan
+    template <typename Fn>
+    uint64_t scan(uint64_t cursor, size_t count, Fn&& fn) const {
+        return table.scan(cursor, count,
+                          [&fn](const T& value, bool) { fn(value); });
+    }
+
+    template <typename Fn>
+    void forEach(Fn&& fn) const {
+        table.forEach([&fn](const T& value, bool) { fn(value); });
+    }
+
+    template <typename Fn>
+    void forEachPartition(size_t part, size_t parts, Fn&& fn) const {
+        table.forEachPartition(part, parts,
+                               [&fn](const T& value, bool) { fn(value); });
+    }
+
+    TableStats stats() const {
+        TableStats stats = table.getStats();
+        if (bloom) {
+            stats.bytes += bloom->getStats().bytes;
+        }
+        return stats;
+    }
+
     void print() const {
         table.print();
     }
@@ -40,5 +133,60 @@ class Set {
     }
 
  private:
-    HashTableOA<T, bool> table;
+    // для int - специализированное представление без хеширования
+    using Storage = std::conditional_t<std::is_same_v<T, int>,
+                                       IntSet, CompactTable<T, bool>>;
+
+    // счетчик, который увеличивает const-поиск, в том числе из
+    // нескольких потоков сразу (SINTER по частям); нужна только сумма,
+    // поэтому порядок операций не важен
+    class Counter {
+     public:
+        Counter() = default;
+        Counter(const Counter& other) : value(other.load()) {}
+
+        Counter& operator=(const Counter& other) {
+            value.store(other.load(), std::memory_order_relaxed);
+            return *this;
+        }
+
+        void increment() {
+            value.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void reset() {
+            value.store(0, std::memory_order_relaxed);
+        }
+
+        size_t load() const {
+            return value.load(std::memory_order_relaxed);
+        }
+
+     private:
+        std::atomic<size_t> value{0};
+    };
+
+    Storage table;
+    std::optional<BloomFilter<T>> bloom;
+    // наблюдаемая статистика фильтра, меняется и в const-поиске
+    mutable Counter bloomChecks;
+    mutable Counter bloomNegatives;
+    mutable Counter bloomFalsePositives;
+
+    void addToFilter(const T& value) {
+        if (bloom) {
+            // элемент еще не в таблице: перестройка учитывает его в размере,
+            // а сам он добавляется после нее
+            rebuildFilterIfNeeded(size() + 1);
+            bloom->add(value);
+        }
+    }
+
+    void rebuildFilterIfNeeded(size_t liveSize) {
+        if (bloom->needsRebuild(liveSize)) {
+            bloom->rebuild(liveSize, [this](auto&& add) {
+                forEach([&add](const T& value) { add(value); });
+            });
+        }
+    }
 };
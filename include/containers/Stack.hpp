@@ -1,56 +1,52 @@
 // Copyright message
 #pragma once
 
+#include <algorithm>
 #include <iostream>
-#include <vector>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <utility>
 #include <stdexcept>
 #include <fstream>
 #include <string>
+#include <vector>
 #include "../utils/StringUtils.hpp"
 
+// размер блока стека в байтах (вместе с указателем на нижний блок)
+const size_t STACK_BLOCK_BYTES = 4096;
 
-const int MAX_STACK_SIZE = 1000000;
-
+// стек на связанных блоках по 4 КиБ: элементы лежат в блоке подряд,
+// память выделяется раз на блок, а не на каждый push. Один опустевший
+// блок держится про запас, чтобы push/pop на границе блока не гоняли
+// его через аллокатор
 template <typename T>
 class Stack {
  public:
-    Stack() : head(nullptr), size(0) {}
-
-    Stack(const Stack& other) : head(nullptr), size(0) {
-        if (!other.head) {
-            return;
-        }
+    Stack() : top(nullptr), spare(nullptr), topCount(0), size(0) {}
 
-        std::vector<T> buf;
-        Node* cur = other.head;
-        while (cur) {
-            buf.push_back(cur->value);
-            cur = cur->next;
-        }
+    // блоки копируются снизу вверх, поэтому порядок сохраняется
+    Stack(const Stack& other) : Stack() {
+        other.forEachBottomUp([this](const T& value) { push(value); });
+    }
 
-        for (int i = static_cast<int>(buf.size()) - 1; i >= 0; --i) {
-            head = new Node(buf[i], head);
-            size++;
-        }
+    Stack(Stack&& other) noexcept : Stack() {
+        swap(other);
     }
 
     Stack<T>& operator=(const Stack& other) {
-        if (this == &other) {
-            return *this;
+        if (this != &other) {
+            Stack tmp(other);
+            swap(tmp);
         }
 
-        clean();
-
-        std::vector<T> buf;
-        Node* cur = other.head;
-        while (cur) {
-            buf.push_back(cur->value);
-            cur = cur->next;
-        }
+        return *this;
+    }
 
-        for (int i = static_cast<int>(buf.size()) - 1; i >= 0; --i) {
-            head = new Node(buf[i], head);
-            size++;
+    Stack<T>& operator=(Stack&& other) noexcept {
+        if (this != &other) {
+            clean();
+            swap(other);
         }
 
         return *this;
@@ -58,13 +54,25 @@ class Stack {
 
     ~Stack() {
         clean();
+        delete spare;
     }
 
     void push(const T& value) {
-        if (size >= MAX_STACK_SIZE)
-            throw std::overflow_error("Error: stack is full!");
+        emplace(value);
+    }
+
+    void push(T&& value) {
+        emplace(std::move(value));
+    }
+
+    template <typename... Args>
+    void emplace(Args&&... args) {
+        if (!top || topCount == BLOCK_ITEMS) {
+            addBlock();
+        }
 
-        head = new Node(value, head);
+        new (top->slot(topCount)) T(std::forward<Args>(args)...);
+        topCount++;
         size++;
     }
 
@@ -72,17 +80,94 @@ class Stack {
         if (size == 0)
             throw std::underflow_error("Error: stack is empty!");
 
-        Node* toDelete = head;
-        head = head->next;
-        delete toDelete;
+        topCount--;
+        top->slot(topCount)->~T();
         size--;
+
+        if (topCount == 0) {
+            releaseTop();
+        }
+    }
+
+    // вставка пачки: последний элемент окажется на вершине; в каждый
+    // блок копируется непрерывный кусок
+    template <typename It>
+    void pushRange(It first, It last) {
+        while (first != last) {
+            if (!top || topCount == BLOCK_ITEMS) {
+                addBlock();
+            }
+            size_t run = std::min(BLOCK_ITEMS - topCount,
+                                  static_cast<size_t>(std::distance(first, last)));
+            std::uninitialized_copy_n(first, run, top->slot(topCount));
+            std::advance(first, run);
+            topCount += run;
+            size += run;
+        }
+    }
+
+    // снимает до count элементов в out (вершина первой), возвращает сколько снято
+    size_t popInto(std::vector<T>& out, size_t count) {
+        count = std::min(count, size);
+        out.reserve(out.size() + count);
+        for (size_t left = count; left > 0;) {
+            size_t run = std::min(left, topCount);
+            for (size_t i = topCount; i > topCount - run; --i) {
+                out.push_back(std::move(*top->slot(i - 1)));
+            }
+            std::destroy_n(top->slot(topCount - run), run);
+            topCount -= run;
+            size -= run;
+            left -= run;
+            if (topCount == 0) {
+                releaseTop();
+            }
+        }
+        return count;
+    }
+
+    // копии элементов [start, start + count) от вершины, без снятия;
+    // целые блоки выше start пропускаются без обхода
+    void copyRange(size_t start, size_t count, std::vector<T>& out) const {
+        if (start >= size) {
+            return;
+        }
+        count = std::min(count, size - start);
+        out.reserve(out.size() + count);
+
+        const Block* block = top;
+        size_t inBlock = topCount;
+        while (start >= inBlock) {
+            start -= inBlock;
+            block = block->below;
+            inBlock = BLOCK_ITEMS;
+        }
+
+        while (count > 0) {
+            size_t run = std::min(count, inBlock - start);
+            for (size_t i = inBlock - start; i > inBlock - start - run; --i) {
+                out.push_back(*block->slot(i - 1));
+            }
+            count -= run;
+            start = 0;
+            block = block->below;
+            inBlock = BLOCK_ITEMS;
+        }
     }
 
     T peek() const {
         if (size == 0)
             throw std::underflow_error("Stack is empty!");
 
-        return head->value;
+        return *top->slot(topCount - 1);
+    }
+
+    // ссылка на вершину, чтобы забрать значение перемещением перед pop()
+    T& peek() {
+        if (size == 0)
+            throw std::underflow_error("Stack is empty!");
+
+        return *top->slot(topCount - 1);
     }
 
     void print() const {
@@ -91,45 +176,116 @@ class Stack {
             return;
         }
 
-        Node* current = head;
         std::cout << "nullptr";
-        while (current) {
-            std::cout << " <- " << current->value;
-            current = current->next;
-        }
+        forEachTopDown([](const T& value) { std::cout << " <- " << value; });
         std::cout << "\n";
     }
 
-    int getSize() const {
+    size_t getSize() const {
         return size;
     }
 
+    // от дна к вершине: push в этом порядке восстанавливает стек
+    template <typename Fn>
+    void forEach(Fn&& fn) const {
+        forEachBottomUp(fn);
+    }
+
+    // от вершины ко дну, как и раньше; внутри блока - подряд по памяти
     void saveElementsToStream(std::ostream& out) const {
-        Node* current = head;
-        while (current != nullptr) {
-            out << StringUtils::toStringValue<T>(current->value) << "|";
-            current = current->next;
-        }
+        forEachTopDown([&out](const T& value) {
+            out << StringUtils::toStringValue<T>(value) << "|";
+        });
     }
 
  private:
-    struct Node {
-        T value;
-        Node* next;
+    struct Block;
+
+    static constexpr size_t BLOCK_ITEMS =
+        (STACK_BLOCK_BYTES - sizeof(void*)) / sizeof(T) > 0
+            ? (STACK_BLOCK_BYTES - sizeof(void*)) / sizeof(T) : 1;
+
+    struct Block {
+        Block* below = nullptr;
+        alignas(T) unsigned char storage[BLOCK_ITEMS * sizeof(T)];
+
+        T* slot(size_t i) {
+            return std::launder(reinterpret_cast<T*>(storage) + i);
+        }
 
-        explicit Node(const T& v, Node* ns = nullptr)
-            : value(v), next(ns) {}
+        const T* slot(size_t i) const {
+            return std::launder(reinterpret_cast<const T*>(storage) + i);
+        }
     };
 
+    void addBlock() {
+        Block* block = spare ? spare : new Block;
+        spare = nullptr;
+        block->below = top;
+        top = block;
+        topCount = 0;
+    }
+
+    // опустевший верхний блок становится запасным
+    void releaseTop() {
+        Block* empty = top;
+        top = top->below;
+        topCount = top ? BLOCK_ITEMS : 0;
+        delete spare;
+        spare = empty;
+    }
+
+    template <typename Fn>
+    void forEachTopDown(Fn&& fn) const {
+        size_t count = topCount;
+        for (const Block* block = top; block; block = block->below) {
+            for (size_t i = count; i > 0; --i) {
+                fn(*block->slot(i - 1));
+            }
+            count = BLOCK_ITEMS;
+        }
+    }
+
+    // блоки связаны только вниз, поэтому сначала собираются в массив
+    template <typename Fn>
+    void forEachBottomUp(Fn&& fn) const {
+        std::vector<const Block*> chain;
+        for (const Block* block = top; block; block = block->below) {
+            chain.push_back(block);
+        }
+
+        for (size_t b = chain.size(); b > 0; --b) {
+            size_t count = b == 1 ? topCount : BLOCK_ITEMS;
+            for (size_t i = 0; i < count; ++i) {
+                fn(*chain[b - 1]->slot(i));
+            }
+        }
+    }
+
+    void swap(Stack& other) noexcept {
+        std::swap(top, other.top);
+        std::swap(spare, other.spare);
+        std::swap(topCount, other.topCount);
+        std::swap(size, other.size);
+    }
+
     void clean() {
-        while (head) {
-            Node* tmp = head;
-            head = head->next;
-            delete tmp;
+        size_t count = topCount;
+        while (top) {
+            for (size_t i = count; i > 0; --i) {
+                top->slot(i - 1)->~T();
+            }
+            Block* below = top->below;
+            delete top;
+            top = below;
+            count = BLOCK_ITEMS;
         }
+        topCount = 0;
         size = 0;
     }
 
-    Node* head;
-    int size;
+    Block* top;
+    Block* spare;
+    size_t topCount;  // занятых ячеек в верхнем блоке
+    size_t size;
 };
@@ -0,0 +1,229 @@
+// Copyright message
+#pragma once
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include "../utils/FileUtils.hpp"
+
+// когда данные журнала доводятся до диска
+enum class FsyncPolicy {
+    Always,    // после каждой записи
+    Interval,  // не чаще раза в заданное число миллисекунд
+    No         // на усмотрение ОС
+};
+
+inline FsyncPolicy parseFsyncPolicy(const std::string& name) {
+    if (name == "always") return FsyncPolicy::Always;
+    if (name == "everysec" || name == "interval") return FsyncPolicy::Interval;
+    if (name == "no") return FsyncPolicy::No;
+    throw std::runtime_error("Unknown fsync policy: '" + name + "' (always, everysec, no)");
+}
+
+// журнал изменяющих команд: файл только дописывается, одна запись -
+// одна строка "<номер> <команда>". Номер растет монотонно и позволяет
+// при воспроизведении пропустить записи, уже вошедшие в снимок
+class AppendLog {
+ public:
+    using Clock = std::chrono::steady_clock;
+
+    AppendLog(const std::string& path, FsyncPolicy policy, int intervalMs)
+        : path(path), policy(policy), interval(std::chrono::milliseconds(intervalMs)),
+          lastSync(Clock::now()) {
+        fd = open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            throw std::runtime_error("Cannot open log " + path + ": " + std::strerror(errno));
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) == 0) {
+            bytes = static_cast<size_t>(st.st_size);
+        }
+        dropTornTail();
+    }
+
+    AppendLog(const AppendLog&) = delete;
+    AppendLog& operator=(const AppendLog&) = delete;
+
+    ~AppendLog() {
+        if (fd >= 0) {
+            if (pending && policy != FsyncPolicy::No) {
+                fdatasync(fd);
+            }
+            close(fd);
+        }
+    }
+
+    void append(uint64_t sequence, const std::string& command) {
+        std::string entry = std::to_string(sequence) + " " + command + "\n";
+        const char* data = entry.data();
+        size_t left = entry.size();
+        while (left > 0) {
+            ssize_t n = write(fd, data, left);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::runtime_error("Cannot write log " + path + ": " + std::strerror(errno));
+            }
+            data += n;
+            left -= static_cast<size_t>(n);
+        }
+        bytes += entry.size();
+        pending = true;
+
+        if (policy == FsyncPolicy::Always) {
+            sync();
+        } else {
+            syncIfDue();
+        }
+    }
+
+    // для политики Interval: вызывается и из цикла сервера, чтобы
+    // последние записи не ждали следующей команды
+    void syncIfDue() {
+        if (policy == FsyncPolicy::Interval && pending && Clock::now() - lastSync >= interval) {
+            sync();
+        }
+    }
+
+    void sync() {
+        if (pending && fdatasync(fd) < 0) {
+            throw std::runtime_error("Cannot sync log " + path + ": " + std::strerror(errno));
+        }
+        pending = false;
+        lastSync = Clock::now();
+    }
+
+    // сколько миллисекунд до обязательного fsync, -1 - не нужно
+    int msUntilSync() const {
+        if (policy != FsyncPolicy::Interval || !pending) {
+            return -1;
+        }
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+            lastSync + interval - Clock::now());
+        return left.count() > 0 ? static_cast<int>(left.count()) : 0;
+    }
+
+    // после записи снимка журнал начинается заново
+    void truncate() {
+        if (ftruncate(fd, 0) < 0) {
+            throw std::runtime_error("Cannot truncate log " + path + ": " + std::strerror(errno));
+        }
+        fsync(fd);
+        bytes = 0;
+        pending = false;
+    }
+
+    // после фонового снимка: первые offset байт в него вошли, остаток,
+    // дописанный за время записи снимка, переносится в новый файл,
+    // который подменяет журнал
+    void discardBefore(size_t offset) {
+        if (offset >= bytes) {
+            truncate();
+            return;
+        }
+
+        std::string tail(bytes - offset, '\0');
+        for (size_t done = 0; done < tail.size();) {
+            ssize_t n = pread(fd, &tail[done], tail.size() - done,
+                              static_cast<off_t>(offset + done));
+            if (n <= 0) {
+                throw std::runtime_error("Cannot read log " + path + ": " + std::strerror(errno));
+            }
+            done += static_cast<size_t>(n);
+        }
+
+        std::string temp = FileUtils::tempPathFor(path);
+        {
+            std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+            out.write(tail.data(), static_cast<std::streamsize>(tail.size()));
+            if (!out) {
+                throw std::runtime_error("Cannot write log " + temp);
+            }
+        }
+        FileUtils::replaceFile(temp, path);
+
+        close(fd);
+        fd = open(path.c_str(), O_RDWR | O_APPEND | O_CLOEXEC);
+        if (fd < 0) {
+            throw std::runtime_error("Cannot open log " + path + ": " + std::strerror(errno));
+        }
+        bytes = tail.size();
+        pending = false;
+    }
+
+    size_t size() const {
+        return bytes;
+    }
+
+    // fn(номер, команда) для каждой целой записи; недописанная
+    // последняя строка (обрыв при сбое) пропускается
+    template <typename Fn>
+    static size_t replay(const std::string& path, Fn&& fn) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            return 0;
+        }
+
+        size_t count = 0;
+        std::string line;
+        while (std::getline(file, line)) {
+            if (file.eof()) {
+                break;  // строка без перевода строки - запись не завершена
+            }
+            size_t space = line.find(' ');
+            if (space == 0 || space == std::string::npos
+                    || line.find_first_not_of("0123456789") != space) {
+                continue;
+            }
+            fn(std::stoull(line.substr(0, space)), line.substr(space + 1));
+            count++;
+        }
+        return count;
+    }
+
+ private:
+    // запись, оборванная сбоем, отрезается, иначе следующая
+    // склеилась бы с ней в одну испорченную строку
+    void dropTornTail() {
+        char buffer[4096];
+        size_t end = bytes;
+        while (end > 0) {
+            size_t chunk = std::min(end, sizeof(buffer));
+            if (pread(fd, buffer, chunk, static_cast<off_t>(end - chunk))
+                    != static_cast<ssize_t>(chunk)) {
+                return;
+            }
+            for (size_t i = chunk; i > 0; --i) {
+                if (buffer[i - 1] == '\n') {
+                    end -= chunk - i;
+                    if (end < bytes && ftruncate(fd, static_cast<off_t>(end)) == 0) {
+                        bytes = end;
+                    }
+                    return;
+                }
+            }
+            end -= chunk;
+        }
+        if (bytes > 0 && ftruncate(fd, 0) == 0) {
+            bytes = 0;
+        }
+    }
+
+    std::string path;
+    FsyncPolicy policy;
+    Clock::duration interval;
+    Clock::time_point lastSync;
+    int fd = -1;
+    size_t bytes = 0;
+    bool pending = false;  // есть записи, не доведенные до диска
+};
@@ -3,6 +3,7 @@
 
 #include <string>
 #include <vector>
+#include <sstream>
 #include <stdexcept>
 #include "../utils/StringUtils.hpp"
 #include "./Database.hpp"
@@ -35,6 +36,12 @@ class CommandParser {
                 return parseSREM(tokens);
             } else if (command == "sismember") {
                 return parseSISMEMBER(tokens);
+            } else if (command == "sinter" || command == "sunion"
+                       || command == "sdiff") {
+                return parseSetAlgebra(command, tokens);
+            } else if (command == "sinterstore" || command == "sunionstore"
+                       || command == "sdiffstore") {
+                return parseSetAlgebraStore(command, tokens);
             } else if (command == "spush") {
                 return parseSPUSH(tokens);
             } else if (command == "spop") {
@@ -43,12 +50,36 @@ class CommandParser {
                 return parseQPUSH(tokens);
             } else if (command == "qpop") {
                 return parseQPOP(tokens);
+            } else if (command == "bqpop") {
+                return parseBQPOP(tokens);
+            } else if (command == "spopn" || command == "qpopn") {
+                return parsePOPN(command, tokens);
+            } else if (command == "srange" || command == "qrange") {
+                return parseRANGE(command, tokens);
             } else if (command == "hset") {
                 return parseHSET(tokens);
             } else if (command == "hdel") {
                 return parseHDEL(tokens);
             } else if (command == "hget") {
                 return parseHGET(tokens);
+            } else if (command == "hscan") {
+                return parseHSCAN(tokens);
+            } else if (command == "sscan") {
+                return parseSSCAN(tokens);
+            } else if (command == "hstats") {
+                return parseHSTATS(tokens);
+            } else if (command == "sstats") {
+                return parseSSTATS(tokens);
+            } else if (command == "sfilter") {
+                return parseSFILTER(tokens);
+            } else if (command == "memory") {
+                return parseMEMORY(tokens);
+            } else if (command == "type") {
+                return parseTYPE(tokens);
+            } else if (command == "del") {
+                return parseDEL(tokens);
+            } else if (command == "exists") {
+                return parseEXISTS(tokens);
             } else {
                 return {false, "", "Unknown command: " + command};
             }
@@ -57,6 +88,21 @@ class CommandParser {
         }
     }
 
+    // меняет ли команда данные (имя в нижнем регистре): после нее
+    // база считается измененной и подлежит сохранению
+    static bool isWriteCommand(const std::string& command) {
+        static const char* const writes[] = {
+            "sadd", "srem", "sinterstore", "sunionstore", "sdiffstore", "sfilter",
+            "spush", "spop", "spopn", "qpush", "qpop", "qpopn", "bqpop",
+            "hset", "hdel", "del"};
+        for (const char* write : writes) {
+            if (command == write) {
+                return true;
+            }
+        }
+        return false;
+    }
+
  private:
     Database<T>& db;
 
@@ -65,11 +111,12 @@ class CommandParser {
             return {false, "", "SADD requires: setName value"};
         }
 
-        std::string setName = tokens[1];
+        const std::string& setName = tokens[1];
         T value = StringUtils::parseValue<T>(tokens[2]);
 
-        db.setAdd(setName, value);
-        return {true, StringUtils::toStringValue<T>(value), ""};
+        std::string output = StringUtils::toStringValue<T>(value);
+        db.setAdd(setName, std::move(value));
+        return {true, std::move(output), ""};
     }
 
     CommandResult parseSREM(const std::vector<std::string>& tokens) {
@@ -77,7 +124,7 @@ class CommandParser {
             return {false, "", "SREM requires: setName value"};
         }
 
-        std::string setName = tokens[1];
+        const std::string& setName = tokens[1];
         T value = StringUtils::parseValue<T>(tokens[2]);
 
         db.setRem(setName, value);
@@ -89,23 +136,65 @@ class CommandParser {
             return {false, "", "SISMEMBER requires: setName value"};
         }
 
-        std::string setName = tokens[1];
+        const std::string& setName = tokens[1];
         T value = StringUtils::parseValue<T>(tokens[2]);
 
         bool result = db.setIsMember(setName, value);
         return {true, result ? "TRUE" : "FALSE", ""};
     }
 
-    CommandResult parseSPUSH(const std::vector<std::string>& tokens) {
+    // SINTER/SUNION/SDIFF key [key ...]
+    CommandResult parseSetAlgebra(const std::string& command,
+                                  const std::vector<std::string>& tokens) {
+        if (tokens.size() < 2) {
+            return {false, "", toUpper(command) + " requires: setName [setName ...]"};
+        }
+
+        std::vector<std::string> names(tokens.begin() + 1, tokens.end());
+        return {true, formatList(runSetAlgebra(command, names)), ""};
+    }
+
+    // SINTERSTORE/SUNIONSTORE/SDIFFSTORE dest key [key ...]
+    CommandResult parseSetAlgebraStore(const std::string& command,
+                                       const std::vector<std::string>& tokens) {
         if (tokens.size() < 3) {
-            return {false, "", "SPUSH requires: stackName value"};
+            return {false, "", toUpper(command) + " requires: destination setName [setName ...]"};
         }
 
-        std::string stackName = tokens[1];
-        T value = StringUtils::parseValue<T>(tokens[2]);
+        std::vector<std::string> names(tokens.begin() + 2, tokens.end());
+        std::string operation = command.substr(0, command.size() - std::string("store").size());
+        size_t size = db.setStore(tokens[1], runSetAlgebra(operation, names));
+        return {true, std::to_string(size), ""};
+    }
 
-        db.stackPush(stackName, value);
-        return {true, StringUtils::toStringValue<T>(value), ""};
+    std::vector<T> runSetAlgebra(const std::string& operation,
+                                 const std::vector<std::string>& names) {
+        if (operation == "sinter") {
+            return db.setInter(names);
+        } else if (operation == "sunion") {
+            return db.setUnion(names);
+        }
+        return db.setDiff(names);
+    }
+
+    static std::string toUpper(std::string str) {
+        for (char& c : str) {
+            c = std::toupper(c);
+        }
+        return str;
+    }
+
+    // SPUSH stack value [value ...] - значения кладутся по порядку,
+    // последнее оказывается на вершине; в ответ - вставленные значения
+    CommandResult parseSPUSH(const std::vector<std::string>& tokens) {
+        if (tokens.size() < 3) {
+            return {false, "", "SPUSH requires: stackName value [value ...]"};
+        }
+
+        std::vector<T> values = parseValues(tokens, 2);
+        std::string output = formatList(values);
+        db.stackPushRange(tokens[1], std::move(values));
+        return {true, std::move(output), ""};
     }
 
     CommandResult parseSPOP(const std::vector<std::string>& tokens) {
@@ -113,21 +202,20 @@ class CommandParser {
             return {false, "", "SPOP requires: stackName"};
         }
 
-        std::string stackName = tokens[1];
+        const std::string& stackName = tokens[1];
         T value = db.stackPop(stackName);
         return {true, StringUtils::toStringValue<T>(value), ""};
     }
 
     CommandResult parseQPUSH(const std::vector<std::string>& tokens) {
         if (tokens.size() < 3) {
-            return {false, "", "QPUSH requires: queueName value"};
+            return {false, "", "QPUSH requires: queueName value [value ...]"};
         }
 
-        std::string queueName = tokens[1];
-        T value = StringUtils::parseValue<T>(tokens[2]);
-
-        db.queuePush(queueName, value);
-        return {true, StringUtils::toStringValue<T>(value), ""};
+        std::vector<T> values = parseValues(tokens, 2);
+        std::string output = formatList(values);
+        db.queuePushRange(tokens[1], std::move(values));
+        return {true, std::move(output), ""};
     }
 
     CommandResult parseQPOP(const std::vector<std::string>& tokens) {
@@ -135,23 +223,103 @@ class CommandParser {
             return {false, "", "QPOP requires: queueName"};
         }
 
-        std::string queueName = tokens[1];
+        const std::string& queueName = tokens[1];
         T value = db.queuePop(queueName);
         return {true, StringUtils::toStringValue<T>(value), ""};
     }
 
+    // BQPOP queue timeout - как QPOP, но пустая очередь не ошибка.
+    // Ждать в разовом запуске некого: писателей, кроме этого процесса,
+    // нет, поэтому при пустой очереди сразу возвращается (nil)
+    CommandResult parseBQPOP(const std::vector<std::string>& tokens) {
+        if (tokens.size() < 3) {
+            return {false, "", "BQPOP requires: queueName timeout"};
+        }
+
+        float timeout = StringUtils::parseValue<float>(tokens[2]);
+        if (timeout < 0) {
+            return {false, "", "timeout must be non-negative"};
+        }
+
+        T value;
+        if (!db.queueTryPop(tokens[1], value)) {
+            return {true, "(nil)", ""};
+        }
+        return {true, StringUtils::toStringValue<T>(value), ""};
+    }
+
+    // SPOPN/QPOPN name count - снимает до count элементов за раз
+    CommandResult parsePOPN(const std::string& command,
+                            const std::vector<std::string>& tokens) {
+        if (tokens.size() < 3) {
+            return {false, "", toUpper(command) + " requires: name count"};
+        }
+
+        int count = StringUtils::parseValue<int>(tokens[2]);
+        if (count <= 0) {
+            return {false, "", "count must be positive"};
+        }
+
+        std::vector<T> values = command == "spopn"
+            ? db.stackPopN(tokens[1], count)
+            : db.queuePopN(tokens[1], count);
+        return {true, formatList(values), ""};
+    }
+
+    // SRANGE/QRANGE name start stop - чтение без извлечения, индексы
+    // от вершины стека или головы очереди
+    CommandResult parseRANGE(const std::string& command,
+                             const std::vector<std::string>& tokens) {
+        if (tokens.size() < 4) {
+            return {false, "", toUpper(command) + " requires: name start stop"};
+        }
+
+        long start = StringUtils::parseValue<int>(tokens[2]);
+        long stop = StringUtils::parseValue<int>(tokens[3]);
+        std::vector<T> values = command == "srange"
+            ? db.stackRange(tokens[1], start, stop)
+            : db.queueRange(tokens[1], start, stop);
+        return {true, formatList(values), ""};
+    }
+
+    std::vector<T> parseValues(const std::vector<std::string>& tokens, size_t first) {
+        std::vector<T> values;
+        values.reserve(tokens.size() - first);
+        for (size_t i = first; i < tokens.size(); ++i) {
+            values.push_back(StringUtils::parseValue<T>(tokens[i]));
+        }
+        return values;
+    }
+
+    // значения построчно, пустой список - "(empty)"
+    static std::string formatList(const std::vector<T>& values) {
+        if (values.empty()) {
+            return "(empty)";
+        }
+
+        std::string output;
+        for (const T& value : values) {
+            if (!output.empty()) {
+                output += "\n";
+            }
+            output += StringUtils::toStringValue<T>(value);
+        }
+        return output;
+    }
+
     // HASH ОПЕРАЦИИ
     CommandResult parseHSET(const std::vector<std::string>& tokens) {
         if (tokens.size() < 4) {
             return {false, "", "HSET requires: hashName key value"};
         }
 
-        std::string hashName = tokens[1];
-        std::string key = tokens[2];
+        const std::string& hashName = tokens[1];
+        const std::string& key = tokens[2];
         T value = StringUtils::parseValue<T>(tokens[3]);
 
-        db.hashSet(hashName, key, value);
-        return {true, StringUtils::toStringValue<T>(value), ""};
+        std::string output = StringUtils::toStringValue<T>(value);
+        db.hashSet(hashName, key, std::move(value));
+        return {true, std::move(output), ""};
     }
 
     CommandResult parseHDEL(const std::vector<std::string>& tokens) {
@@ -159,8 +327,8 @@ class CommandParser {
             return {false, "", "HDEL requires: hashName key"};
         }
 
-        std::string hashName = tokens[1];
-        std::string key = tokens[2];
+        const std::string& hashName = tokens[1];
+        const std::string& key = tokens[2];
 
         db.hashDel(hashName, key);
         return {true, key, ""};
@@ -171,14 +339,177 @@ class CommandParser {
             return {false, "", "HGET requires: hashName key"};
         }
 
-        std::string hashName = tokens[1];
-        std::string key = tokens[2];
+        const std::string& hashName = tokens[1];
+        const std::string& key = tokens[2];
 
         try {
-            T value = db.hashGet(hashName, key);
-            return {true, StringUtils::toStringValue<T>(value), ""};
+            const T* value = db.hashGet(hashName, key);
+            if (!value) {
+                return {true, "(nil)", ""};
+            }
+            return {true, StringUtils::toStringValue<T>(*value), ""};
         } catch (...) {
             return {true, "(nil)", ""};
         }
     }
+
+    // ОБХОД ПО КУРСОРУ: первая строка ответа - курсор продолжения
+    CommandResult parseHSCAN(const std::vector<std::string>& tokens) {
+        if (tokens.size() < 3) {
+            return {false, "", "HSCAN requires: hashName cursor [COUNT n]"};
+        }
+
+        std::string items;
+        uint64_t next = db.hashScan(tokens[1], parseCursor(tokens[2]),
+                                    parseScanCount(tokens),
+            [&items](const std::string& key, const T& value) {
+                items += "\n" + key + "\n" + StringUtils::toStringValue<T>(value);
+            });
+        return {true, std::to_string(next) + items, ""};
+    }
+
+    CommandResult parseSSCAN(const std::vector<std::string>& tokens) {
+        if (tokens.size() < 3) {
+            return {false, "", "SSCAN requires: setName cursor [COUNT n]"};
+        }
+
+        std::string items;
+        uint64_t next = db.setScan(tokens[1], parseCursor(tokens[2]),
+                                   parseScanCount(tokens),
+            [&items](const T& value) {
+                items += "\n" + StringUtils::toStringValue<T>(value);
+            });
+        return {true, std::to_string(next) + items, ""};
+    }
+
+    static uint64_t parseCursor(const std::string& token) {
+        try {
+            size_t pos = 0;
+            uint64_t cursor = std::stoull(token, &pos);
+            if (pos == token.size()) {
+                return cursor;
+            }
+        } catch (const std::exception&) {
+        }
+        throw std::runtime_error("Invalid cursor: '" + token + "'");
+    }
+
+    static size_t parseScanCount(const std::vector<std::string>& tokens) {
+        if (tokens.size() >= 5 && StringUtils::toLower(tokens[3]) == "count") {
+            int count = StringUtils::parseValue<int>(tokens[4]);
+            if (count <= 0) {
+                throw std::runtime_error("COUNT must be positive");
+            }
+            return static_cast<size_t>(count);
+        }
+        return 10;
+    }
+
+    // ДИАГНОСТИКА
+    CommandResult parseHSTATS(const std::vector<std::string>& tokens) {
+        if (tokens.size() < 2) {
+            return {false, "", "HSTATS requires: hashName"};
+        }
+
+        return {true, formatStats(db.hashStats(tokens[1])), ""};
+    }
+
+    CommandResult parseSSTATS(const std::vector<std::string>& tokens) {
+        if (tokens.size() < 2) {
+            return {false, "", "SSTATS requires: setName"};
+        }
+
+        std::string output = formatStats(db.setStats(tokens[1]));
+        BloomStats bloom = db.setFilterStats(tokens[1]);
+        if (bloom.enabled) {
+            output += "\n" + formatFilterStats(bloom);
+        }
+        return {true, output, ""};
+    }
+
+    // SFILTER set ON [fpr] | OFF - фильтр Блума для отрицательных SISMEMBER
+    CommandResult parseSFILTER(const std::vector<std::string>& tokens) {
+        if (tokens.size() < 3) {
+            return {false, "", "SFILTER requires: setName ON [fpr] | OFF"};
+        }
+
+        std::string mode = StringUtils::toLower(tokens[2]);
+        if (mode == "off") {
+            db.setFilter(tokens[1], 0.0);
+            return {true, "OK", ""};
+        }
+        if (mode != "on") {
+            return {false, "", "SFILTER mode must be ON or OFF"};
+        }
+
+        double fpr = tokens.size() >= 4 ? StringUtils::parseValue<float>(tokens[3]) : 0.01;
+        if (!(fpr > 0.0 && fpr < 1.0)) {
+            return {false, "", "SFILTER fpr must be in (0, 1)"};
+        }
+        db.setFilter(tokens[1], fpr);
+        return {true, "OK", ""};
+    }
+
+    CommandResult parseMEMORY(const std::vector<std::string>& tokens) {
+        if (tokens.size() < 3 || StringUtils::toLower(tokens[1]) != "usage") {
+            return {false, "", "MEMORY requires: USAGE name"};
+        }
+
+        return {true, std::to_string(db.memoryUsage(tokens[2])), ""};
+    }
+
+    CommandResult parseTYPE(const std::vector<std::string>& tokens) {
+        if (tokens.size() < 2) {
+            return {false, "", "TYPE requires: name"};
+        }
+
+        return {true, db.keyType(tokens[1]), ""};
+    }
+
+    // DEL name [name ...] - ключи любого типа, ответ - число удаленных
+    CommandResult parseDEL(const std::vector<std::string>& tokens) {
+        if (tokens.size() < 2) {
+            return {false, "", "DEL requires: name [name ...]"};
+        }
+
+        std::vector<std::string> names(tokens.begin() + 1, tokens.end());
+        return {true, std::to_string(db.del(names)), ""};
+    }
+
+    CommandResult parseEXISTS(const std::vector<std::string>& tokens) {
+        if (tokens.size() < 2) {
+            return {false, "", "EXISTS requires: name [name ...]"};
+        }
+
+        std::vector<std::string> names(tokens.begin() + 1, tokens.end());
+        return {true, std::to_string(db.exists(names)), ""};
+    }
+
+    static std::string formatStats(const TableStats& stats) {
+        std::ostringstream out;
+        out << "encoding: " << stats.encoding << "\n"
+            << "size: " << stats.size << "\n"
+            << "capacity: " << stats.capacity << "\n"
+            << "load_factor: " << stats.loadFactor << "\n"
+            << "tombstones: " << stats.tombstones << "\n"
+            << "avg_probe: " << stats.avgProbe << "\n"
+            << "max_probe: " << stats.maxProbe << "\n"
+            << "bytes: " << stats.bytes << "\n"
+            << "rehashing: " << (stats.rehashing ? "yes" : "no");
+        return out.str();
+    }
+
+    static std::string formatFilterStats(const BloomStats& stats) {
+        std::ostringstream out;
+        out << "bloom_target_fpr: " << stats.targetFpr << "\n"
+            << "bloom_estimated_fpr: " << stats.estimatedFpr << "\n"
+            << "bloom_capacity: " << stats.capacity << "\n"
+            << "bloom_blocks: " << stats.blocks << "\n"
+            << "bloom_bytes: " << stats.bytes << "\n"
+            << "bloom_removed: " << stats.removed << "\n"
+            << "bloom_checks: " << stats.checks << "\n"
+            << "bloom_negatives: " << stats.negatives << "\n"
+            << "bloom_false_positives: " << stats.falsePositives;
+        return out.str();
+    }
 };
@@ -1,256 +1,1229 @@
 // Copyright
 #pragma once
 
+#include <unistd.h>
+
 #include <string>
+#include <string_view>
 #include <iostream>
 #include <map>
+#include <set>
 #include <memory>
 #include <vector>
 #include <fstream>
 #include <sstream>
 #include <stdexcept>
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <variant>
 #include "../containers/Set.hpp"
 #include "../containers/Stack.hpp"
 #include "../containers/Queue.hpp"
+#include "../containers/CompactTable.hpp"
 #include "../containers/HashTableOA.hpp"
+#include "../utils/FileUtils.hpp"
 #include "../utils/StringUtils.hpp"
+#include "./Snapshot.hpp"
 
 template<typename T>
 class Database {
  public:
+    using Hash = CompactTable<std::string, T>;
+
     explicit Database(const std::string& filename)
         : filename(filename) {}
 
     ~Database() = default;
 
+    // существующий ключ находится одной пробой таблицы
     void setAdd(const std::string& setName, const T& value) {
-        if (sets.find(setName) == sets.end()) {
-            sets[setName] = Set<T>();
-        }
-        sets[setName].insert(value);
+        touch(snapshot::Kind::Set, setName);
+        findOrCreate<Set<T>>(setName).insert(value);
+    }
+
+    void setAdd(const std::string& setName, T&& value) {
+        touch(snapshot::Kind::Set, setName);
+        findOrCreate<Set<T>>(setName).insert(std::move(value));
     }
 
     void setRem(const std::string& setName, const T& value) {
-        auto it = sets.find(setName);
-        if (it == sets.end()) {
+        touch(snapshot::Kind::Set, setName);
+        Set<T>* set = find<Set<T>>(setName);
+        if (!set) {
             throw std::runtime_error("Set '" + setName + "' not found");
         }
-        it->second.remove(value);
+        set->remove(value);
     }
 
     bool setIsMember(const std::string& setName, const T& value) const {
-        auto it = sets.find(setName);
-        if (it == sets.end()) {
+        const Set<T>* set = find<Set<T>>(setName);
+        if (!set) {
             throw std::runtime_error("Set '" + setName + "' not found");
         }
-        return it->second.contains(value);
+        return set->contains(value);
     }
 
-    void stackPush(const std::string& stackName, const T& value) {
-        if (stacks.find(stackName) == stacks.end()) {
-            stacks[stackName] = Stack<T>();
+    // пересечение: обходится самое маленькое множество, остальные
+    // только проверяются; отсутствующее множество считается пустым
+    std::vector<T> setInter(const std::vector<std::string>& names) const {
+        std::vector<const Set<T>*> inputs;
+        for (const auto& name : names) {
+            const Set<T>* set = find<Set<T>>(name);
+            if (!set || set->size() == 0) {
+                return {};
+            }
+            inputs.push_back(set);
+        }
+        if (inputs.empty()) {
+            return {};
+        }
+
+        std::sort(inputs.begin(), inputs.end(),
+                  [](const Set<T>* a, const Set<T>* b) { return a->size() < b->size(); });
+
+        const Set<T>& smallest = *inputs.front();
+        auto inAll = [&inputs](const T& value) {
+            for (size_t i = 1; i < inputs.size(); ++i) {
+                if (!inputs[i]->contains(value)) {
+                    return false;
+                }
+            }
+            return true;
+        };
+
+        size_t parts = intersectPartitions(smallest.size());
+        std::vector<std::vector<T>> partial(parts);
+        if (parts == 1) {
+            smallest.forEach([&](const T& value) {
+                if (inAll(value)) {
+                    partial[0].push_back(value);
+                }
+            });
+            return std::move(partial[0]);
+        }
+
+        // таблицы только читаются, поэтому части обходятся без блокировок
+        std::vector<std::thread> workers;
+        for (size_t part = 0; part < parts; ++part) {
+            workers.emplace_back([&, part] {
+                smallest.forEachPartition(part, parts, [&](const T& value) {
+                    if (inAll(value)) {
+                        partial[part].push_back(value);
+                    }
+                });
+            });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+
+        std::vector<T> result;
+        for (auto& chunk : partial) {
+            std::move(chunk.begin(), chunk.end(), std::back_inserter(result));
+        }
+        return result;
+    }
+
+    std::vector<T> setUnion(const std::vector<std::string>& names) const {
+        Set<T> seen;
+        std::vector<T> result;
+        for (const auto& name : names) {
+            const Set<T>* set = find<Set<T>>(name);
+            if (!set) {
+                continue;
+            }
+            set->forEach([&](const T& value) {
+                if (!seen.contains(value)) {
+                    seen.insert(value);
+                    result.push_back(value);
+                }
+            });
+        }
+        return result;
+    }
+
+    // элементы первого множества, которых нет ни в одном из остальных
+    std::vector<T> setDiff(const std::vector<std::string>& names) const {
+        std::vector<T> result;
+        const Set<T>* first = names.empty() ? nullptr : find<Set<T>>(names[0]);
+        if (!first) {
+            return result;
+        }
+
+        std::vector<const Set<T>*> others;
+        for (size_t i = 1; i < names.size(); ++i) {
+            const Set<T>* other = find<Set<T>>(names[i]);
+            if (other && other->size() > 0) {
+                others.push_back(other);
+            }
+        }
+
+        first->forEach([&](const T& value) {
+            for (const Set<T>* other : others) {
+                if (other->contains(value)) {
+                    return;
+                }
+            }
+            result.push_back(value);
+        });
+        return result;
+    }
+
+    // результат операции заменяет ключ dest любого типа,
+    // пустой результат его удаляет
+    size_t setStore(const std::string& dest, std::vector<T>&& elements) {
+        touch(snapshot::Kind::Set, dest);
+        if (elements.empty()) {
+            remove(dest);
+            return 0;
         }
-        stacks[stackName].push(value);
+
+        Set<T> result(static_cast<int>(elements.size()));
+        for (T& value : elements) {
+            result.insert(std::move(value));
+        }
+        size_t size = result.size();
+        keyspace.emplace(dest, std::make_unique<Object>(std::move(result)));
+        return size;
+    }
+
+    void stackPush(const std::string& stackName, const T& value) {
+        touch(snapshot::Kind::Stack, stackName);
+        findOrCreate<Stack<T>>(stackName).push(value);
+    }
+
+    void stackPush(const std::string& stackName, T&& value) {
+        touch(snapshot::Kind::Stack, stackName);
+        findOrCreate<Stack<T>>(stackName).push(std::move(value));
     }
 
     T stackPop(const std::string& stackName) {
-        auto it = stacks.find(stackName);
-        if (it == stacks.end() || it->second.getSize() == 0) {
+        touch(snapshot::Kind::Stack, stackName);
+        Stack<T>* stack = find<Stack<T>>(stackName);
+        if (!stack || stack->getSize() == 0) {
             throw std::runtime_error("Stack '" + stackName + "' is empty or not found");
         }
 
-        T value = it->second.peek();
-        it->second.pop();
+        T value = std::move(stack->peek());
+        stack->pop();
         return value;
     }
 
-    void queuePush(const std::string& queueName, const T& value) {
-        if (queues.find(queueName) == queues.end()) {
-            queues[queueName] = myQueue<T>();
+    // пачка уходит в стек одним вызовом, последний элемент - на вершине
+    void stackPushRange(const std::string& stackName, std::vector<T>&& values) {
+        touch(snapshot::Kind::Stack, stackName);
+        findOrCreate<Stack<T>>(stackName).pushRange(
+            std::make_move_iterator(values.begin()), std::make_move_iterator(values.end()));
+    }
+
+    std::vector<T> stackPopN(const std::string& stackName, size_t count) {
+        touch(snapshot::Kind::Stack, stackName);
+        Stack<T>* stack = find<Stack<T>>(stackName);
+        if (!stack || stack->getSize() == 0) {
+            throw std::runtime_error("Stack '" + stackName + "' is empty or not found");
+        }
+
+        std::vector<T> values;
+        stack->popInto(values, count);
+        return values;
+    }
+
+    // элементы с start по stop включительно от вершины, отрицательные
+    // индексы считаются с конца
+    std::vector<T> stackRange(const std::string& stackName, long start, long stop) const {
+        const Stack<T>* stack = find<Stack<T>>(stackName);
+        if (!stack) {
+            throw std::runtime_error("Stack '" + stackName + "' not found");
+        }
+
+        std::vector<T> values;
+        size_t from, count;
+        if (clampRange(start, stop, stack->getSize(), from, count)) {
+            stack->copyRange(from, count, values);
         }
-        queues[queueName].push(value);
+        return values;
+    }
+
+    void queuePush(const std::string& queueName, const T& value) {
+        touch(snapshot::Kind::Queue, queueName);
+        findOrCreate<myQueue<T>>(queueName).push(value);
+    }
+
+    void queuePush(const std::string& queueName, T&& value) {
+        touch(snapshot::Kind::Queue, queueName);
+        findOrCreate<myQueue<T>>(queueName).push(std::move(value));
     }
 
     T queuePop(const std::string& queueName) {
-        auto it = queues.find(queueName);
-        if (it == queues.end() || it->second.getSize() == 0) {
+        touch(snapshot::Kind::Queue, queueName);
+        myQueue<T>* queue = find<myQueue<T>>(queueName);
+        if (!queue || queue->getSize() == 0) {
             throw std::runtime_error("Queue '" + queueName + "' is empty or not found");
         }
 
-        T value = it->second.front();
-        it->second.pop();
+        T value = std::move(queue->front());
+        queue->pop();
         return value;
     }
 
-    void hashSet(const std::string& hashName, const std::string& key, const T& value) {
-        if (hashes.find(hashName) == hashes.end()) {
-            hashes[hashName] = HashTableOA<std::string, T>(1000);
+    // без исключения для пустой очереди - для блокирующего извлечения
+    bool queueTryPop(const std::string& queueName, T& out) {
+        touch(snapshot::Kind::Queue, queueName);
+        myQueue<T>* queue = find<myQueue<T>>(queueName);
+        if (!queue || queue->getSize() == 0) {
+            return false;
         }
-        hashes[hashName].insert(key, value);
+
+        out = std::move(queue->front());
+        queue->pop();
+        return true;
     }
 
-    void hashDel(const std::string& hashName, const std::string& key) {
-        auto it = hashes.find(hashName);
-        if (it == hashes.end()) {
-            throw std::runtime_error("Hash '" + hashName + "' not found");
+    void queuePushRange(const std::string& queueName, std::vector<T>&& values) {
+        touch(snapshot::Kind::Queue, queueName);
+        findOrCreate<myQueue<T>>(queueName).pushRange(
+            std::make_move_iterator(values.begin()), std::make_move_iterator(values.end()));
+    }
+
+    std::vector<T> queuePopN(const std::string& queueName, size_t count) {
+        touch(snapshot::Kind::Queue, queueName);
+        myQueue<T>* queue = find<myQueue<T>>(queueName);
+        if (!queue || queue->getSize() == 0) {
+            throw std::runtime_error("Queue '" + queueName + "' is empty or not found");
         }
-        it->second.remove(key);
+
+        std::vector<T> values;
+        queue->popInto(values, count);
+        return values;
     }
 
-    T hashGet(const std::string& hashName, const std::string& key) const {
-        auto it = hashes.find(hashName);
-        if (it == hashes.end()) {
-            throw std::runtime_error("Hash '" + hashName + "' not found");
+    // элементы с start по stop включительно от головы
+    std::vector<T> queueRange(const std::string& queueName, long start, long stop) const {
+        const myQueue<T>* queue = find<myQueue<T>>(queueName);
+        if (!queue) {
+            throw std::runtime_error("Queue '" + queueName + "' not found");
+        }
+
+        std::vector<T> values;
+        size_t from, count;
+        if (clampRange(start, stop, queue->getSize(), from, count)) {
+            queue->copyRange(from, count, values);
+        }
+        return values;
+    }
+
+    void hashSet(const std::string& hashName, std::string_view key, T value) {
+        touch(snapshot::Kind::Hash, hashName);
+        findOrCreate<Hash>(hashName).emplace(key, std::move(value));
+    }
+
+    void hashDel(const std::string& hashName, std::string_view key) {
+        touch(snapshot::Kind::Hash, hashName);
+        requireHash(hashName).remove(key);
+    }
+
+    // указатель на значение внутри таблицы, nullptr если ключа нет
+    const T* hashGet(const std::string& hashName, std::string_view key) const {
+        return requireHash(hashName).get(key);
+    }
+
+    // fn(key, value) для порции полей, возвращает курсор продолжения
+    template <typename Fn>
+    uint64_t hashScan(const std::string& hashName, uint64_t cursor, size_t count,
+                      Fn&& fn) const {
+        return requireHash(hashName).scan(cursor, count, fn);
+    }
+
+    template <typename Fn>
+    uint64_t setScan(const std::string& setName, uint64_t cursor, size_t count,
+                     Fn&& fn) const {
+        return requireSet(setName).scan(cursor, count, fn);
+    }
+
+    TableStats hashStats(const std::string& hashName) const {
+        return requireHash(hashName).getStats();
+    }
+
+    TableStats setStats(const std::string& setName) const {
+        return requireSet(setName).stats();
+    }
+
+    // fpr > 0 ставит перед множеством фильтр Блума, 0 - убирает его
+    void setFilter(const std::string& setName, double fpr) {
+        touch(snapshot::Kind::Set, setName);
+        Set<T>* set = find<Set<T>>(setName);
+        if (!set) {
+            throw std::runtime_error("Set '" + setName + "' not found");
+        }
+        if (fpr > 0.0) {
+            set->enableFilter(fpr);
+        } else {
+            set->disableFilter();
+        }
+    }
+
+    BloomStats setFilterStats(const std::string& setName) const {
+        return requireSet(setName).filterStats();
+    }
+
+    // объем памяти хеша или множества с таким именем
+    size_t memoryUsage(const std::string& name) const {
+        const std::unique_ptr<Object>* object = keyspace.get(name);
+        if (!object) {
+            throw std::runtime_error("Key '" + name + "' not found");
+        }
+        if (const Hash* hash = std::get_if<Hash>(object->get())) {
+            return hash->getStats().bytes;
         }
-        return it->second.find(key);
+        if (const Set<T>* set = std::get_if<Set<T>>(object->get())) {
+            return set->stats().bytes;
+        }
+        throw std::runtime_error("MEMORY USAGE is not supported for "
+                                 + std::string(typeName(**object)) + " '" + name + "'");
+    }
+
+    // тип ключа для TYPE: "set", "stack", "queue", "hash" или "none"
+    std::string keyType(const std::string& name) const {
+        const std::unique_ptr<Object>* object = keyspace.get(name);
+        return object ? typeName(**object) : "none";
+    }
+
+    // сколько из перечисленных ключей было удалено
+    size_t del(const std::vector<std::string>& names) {
+        size_t deleted = 0;
+        for (const auto& name : names) {
+            deleted += remove(name) ? 1 : 0;
+        }
+        return deleted;
+    }
+
+    // сколько из перечисленных ключей существует, повторы считаются
+    size_t exists(const std::vector<std::string>& names) const {
+        size_t found = 0;
+        for (const auto& name : names) {
+            found += keyspace.isPresent(name) ? 1 : 0;
+        }
+        return found;
+    }
+
+    uint64_t getLogSequence() const {
+        return logSequence;
+    }
+
+    void setLogSequence(uint64_t sequence) {
+        headerDirty = headerDirty || sequence != logSequence;
+        logSequence = sequence;
     }
 
+    const std::string& getFilename() const {
+        return filename;
+    }
+
+    // в каком виде пишет save(); load() понимает оба
+    void setFormat(SnapshotFormat snapshotFormat) {
+        format = snapshotFormat;
+    }
 
     void load() {
-        std::ifstream file(filename);
-        if (!file.is_open()) {
-            return;  // файл не существует - создастчя при save()
+        loadFrom(filename);
+    }
+
+    // переписываются только измененные структуры: в двоичном виде
+    // остальные записи копируются байтами из прежнего снимка, а если
+    // не менялось ничего, файл не трогается вовсе
+    void save() {
+        if (format == SnapshotFormat::Text) {
+            saveText(filename);
+            markClean(false);
+            return;
+        }
+
+        bool unchanged = !allDirty && cleanStamp.exists()
+            && snapshot::FileStamp::of(filename) == cleanStamp;
+        if (unchanged && dirty.empty() && !headerDirty) {
+            return;
+        }
+        std::unique_ptr<snapshot::Image> previous = unchanged ? previousSnapshot() : nullptr;
+        saveBinary(filename, previous.get());
+        markClean(true);
+    }
+
+    // снимок пишет дочерний процесс с копией памяти на момент fork
+    // (ядро копирует страницы лениво, только измененные родителем),
+    // а вызывающий сразу продолжает работу; возвращает pid потомка
+    pid_t saveInBackground() {
+        pid_t pid = fork();
+        if (pid < 0) {
+            throw std::runtime_error(std::string("Cannot fork: ") + std::strerror(errno));
+        }
+        if (pid == 0) {
+            int status = 0;
+            try {
+                save();
+            } catch (const std::exception& e) {
+                std::cerr << "Background save failed: " << e.what() << "\n";
+                status = 1;
+            }
+            _exit(status);
+        }
+
+        // изменения после fork в этот снимок уже не попадут
+        saving = {std::move(dirty), headerDirty, allDirty};
+        dirty.clear();
+        headerDirty = allDirty = false;
+        return pid;
+    }
+
+    // итог фоновой записи: при успехе файл соответствует памяти на
+    // момент fork, при неудаче отложенные изменения снова ждут записи
+    void finishBackgroundSave(bool saved) {
+        if (saved) {
+            cleanStamp = format == SnapshotFormat::Binary
+                ? snapshot::FileStamp::of(filename) : snapshot::FileStamp();
+        } else {
+            dirty.insert(saving.dirty.begin(), saving.dirty.end());
+            headerDirty = headerDirty || saving.headerDirty;
+            allDirty = allDirty || saving.allDirty;
+        }
+        saving = {};
+    }
+
+    // импорт: содержимое другого файла в любом из форматов
+    void loadFrom(const std::string& path) {
+        bool binary = snapshot::isSnapshot(path);
+        if (binary) {
+            loadBinary(path);
+        } else {
+            loadText(path);
+        }
+        markClean(binary && path == filename);
+    }
+
+    // экспорт: текстовый вид годится для правки руками и других программ
+    void saveTo(const std::string& path, SnapshotFormat snapshotFormat) const {
+        if (snapshotFormat == SnapshotFormat::Binary) {
+            saveBinary(path, nullptr);
+        } else {
+            saveText(path);
+        }
+    }
+
+ private:
+    // номер последней записи журнала, вошедшей в снимок; для старых
+    // читателей это обычный комментарий
+    static inline const std::string LOG_SEQUENCE_TAG = "# log-sequence: ";
+    static const size_t MAX_DIRTY_TRACKED = 1 << 16;
+
+    std::string filename;
+    SnapshotFormat format = SnapshotFormat::Binary;
+    uint64_t logSequence = 0;
+
+    // что изменилось с последней записи или чтения файла. Прежний снимок
+    // годится как источник записей, только пока файл тот же, что мы
+    // записали или прочли: это проверяется по inode, размеру и времени
+    using DirtySet = std::set<std::pair<snapshot::Kind, std::string>>;
+
+    DirtySet dirty;
+    bool headerDirty = false;
+    bool allDirty = false;  // изменений слишком много - проще переписать все
+    snapshot::FileStamp cleanStamp;
+
+    // то, что пишет фоновая запись, до ее завершения
+    struct {
+        DirtySet dirty;
+        bool headerDirty = false;
+        bool allDirty = false;
+    } saving;
+
+    void touch(snapshot::Kind kind, const std::string& name) {
+        if (dirty.size() < MAX_DIRTY_TRACKED) {
+            dirty.emplace(kind, name);
+        } else {
+            allDirty = true;
+        }
+    }
+
+    void markClean(bool reusable) {
+        dirty.clear();
+        headerDirty = allDirty = false;
+        cleanStamp = reusable ? snapshot::FileStamp::of(filename) : snapshot::FileStamp();
+    }
+
+    // файл тот же, что мы записали или прочли, поэтому сумма
+    // уже проверена и повторно не считается
+    std::unique_ptr<snapshot::Image> previousSnapshot() const {
+        try {
+            auto image = std::make_unique<snapshot::Image>(filename, snapshot::valueTag<T>(), false);
+            // записи снимка другого типа значений не копируются
+            return image->valueTag() == snapshot::valueTag<T>() ? std::move(image) : nullptr;
+        } catch (const std::runtime_error&) {
+            return nullptr;  // испорчен - пишется целиком
+        }
+    }
+
+    // индексы как в LRANGE: отрицательные - с конца, выход за границы
+    // обрезается; false, если диапазон пуст
+    static bool clampRange(long start, long stop, size_t size, size_t& from, size_t& count) {
+        long n = static_cast<long>(size);
+        if (start < 0) start += n;
+        if (stop < 0) stop += n;
+        start = std::max(start, 0L);
+        stop = std::min(stop, n - 1);
+        if (start > stop) {
+            return false;
+        }
+        from = static_cast<size_t>(start);
+        count = static_cast<size_t>(stop - start + 1);
+        return true;
+    }
+
+    // все ключи базы в одной таблице: имя занято одной структурой
+    // любого типа. В ячейке лежит указатель, поэтому ячейка мала,
+    // а структура не переезжает при росте таблицы
+    using Object = std::variant<Set<T>, Stack<T>, myQueue<T>, Hash>;
+    HashTableOA<std::string, std::unique_ptr<Object>> keyspace;
+
+    template <typename Structure>
+    static constexpr snapshot::Kind kindOf() {
+        if constexpr (std::is_same_v<Structure, Set<T>>) {
+            return snapshot::Kind::Set;
+        } else if constexpr (std::is_same_v<Structure, Stack<T>>) {
+            return snapshot::Kind::Stack;
+        } else if constexpr (std::is_same_v<Structure, myQueue<T>>) {
+            return snapshot::Kind::Queue;
+        } else {
+            return snapshot::Kind::Hash;
+        }
+    }
+
+    static snapshot::Kind kindOf(const Object& object) {
+        return std::visit([](const auto& structure) {
+            return kindOf<std::decay_t<decltype(structure)>>();
+        }, object);
+    }
+
+    static const char* typeName(snapshot::Kind kind) {
+        switch (kind) {
+            case snapshot::Kind::Set: return "set";
+            case snapshot::Kind::Stack: return "stack";
+            case snapshot::Kind::Queue: return "queue";
+            default: return "hash";
+        }
+    }
+
+    static const char* typeName(const Object& object) {
+        return typeName(kindOf(object));
+    }
+
+    template <typename Structure>
+    static Structure* as(std::string_view name, Object& object) {
+        Structure* structure = std::get_if<Structure>(&object);
+        if (!structure) {
+            throw std::runtime_error("Key '" + std::string(name) + "' holds a "
+                                     + typeName(object) + ", not a "
+                                     + typeName(kindOf<Structure>()));
+        }
+        return structure;
+    }
+
+    // nullptr, если ключа нет; ключ другого типа - ошибка
+    template <typename Structure>
+    const Structure* find(std::string_view name) const {
+        const std::unique_ptr<Object>* object = keyspace.get(name);
+        return object ? as<Structure>(name, **object) : nullptr;
+    }
+
+    template <typename Structure>
+    Structure* find(std::string_view name) {
+        std::unique_ptr<Object>* object = keyspace.get(name);
+        return object ? as<Structure>(name, **object) : nullptr;
+    }
+
+    // поиск и вставка за одну пробу таблицы
+    template <typename Structure>
+    Structure& findOrCreate(const std::string& name) {
+        auto [object, created] = keyspace.tryEmplace(name);
+        if (created) {
+            try {
+                *object = std::make_unique<Object>(std::in_place_type<Structure>);
+            } catch (...) {
+                keyspace.remove(name);
+                throw;
+            }
+        }
+        return *as<Structure>(name, **object);
+    }
+
+    const Hash& requireHash(const std::string& hashName) const {
+        const Hash* hash = find<Hash>(hashName);
+        if (!hash) {
+            throw std::runtime_error("Hash '" + hashName + "' not found");
         }
+        return *hash;
+    }
 
-        std::string line;
-        while (std::getline(file, line)) {
-            if (line.empty() || line[0] == '#') continue;
+    Hash& requireHash(const std::string& hashName) {
+        return const_cast<Hash&>(std::as_const(*this).requireHash(hashName));
+    }
 
-            size_t colonPos = line.find(':');
-            size_t pipePos = line.find('|');
+    const Set<T>& requireSet(const std::string& setName) const {
+        const Set<T>* set = find<Set<T>>(setName);
+        if (!set) {
+            throw std::runtime_error("Set '" + setName + "' not found");
+        }
+        return *set;
+    }
+
+    // удаленный ключ просто не попадет в следующий снимок
+    bool remove(const std::string& name) {
+        const std::unique_ptr<Object>* object = keyspace.get(name);
+        if (!object) {
+            return false;
+        }
+        touch(kindOf(**object), name);
+        return keyspace.remove(name);
+    }
 
-            if (colonPos == std::string::npos || pipePos == std::string::npos) {
+    // разобранная часть файла; до слияния принадлежит одному потоку
+    struct LoadedPart {
+        std::vector<std::pair<std::string, std::unique_ptr<Object>>> objects;
+        std::vector<std::pair<std::string, double>> filters;
+
+        template <typename Structure, typename... Args>
+        Structure& add(std::string_view name, Args&&... args) {
+            objects.emplace_back(std::string(name), std::make_unique<Object>(
+                std::in_place_type<Structure>, std::forward<Args>(args)...));
+            return std::get<Structure>(*objects.back().second);
+        }
+    };
+
+    // строки независимы, поэтому файл режется на куски по границам
+    // строк и разбирается несколькими потоками; каждый поток собирает
+    // свою часть отдельно, а части сливаются в реестры по порядку.
+    // Очень длинная строка (одна большая структура) режется по '|'
+    // и разбирается всеми потоками сразу
+    void loadText(const std::string& path) {
+        if (!snapshot::FileStamp::of(path).exists()) {
+            return;  // файл не существует - создастся при save()
+        }
+        snapshot::MappedFile file(path);
+        std::string_view text(file.begin(), file.size());
+
+        std::vector<std::string_view> lines;
+        for (size_t begin = 0; begin < text.size();) {
+            size_t end = text.find('\n', begin);
+            if (end == std::string_view::npos) {
+                end = text.size();
+            }
+            std::string_view line = text.substr(begin, end - begin);
+            begin = end + 1;
+
+            if (line.substr(0, LOG_SEQUENCE_TAG.size()) == LOG_SEQUENCE_TAG) {
+                logSequence = std::stoull(std::string(line.substr(LOG_SEQUENCE_TAG.size())));
                 continue;
             }
+            if (!line.empty() && line[0] != '#') {
+                lines.push_back(line);
+            }
+        }
 
-            std::string name = line.substr(0, colonPos);
-            std::string type = line.substr(colonPos + 1, pipePos - colonPos - 1);
-            std::string data = line.substr(pipePos + 1);
+        // куски: подряд идущие обычные строки примерно поровну по байтам,
+        // длинная строка - отдельным куском
+        size_t threads = loadThreads(text.size());
+        size_t chunkBytes = std::max<size_t>(text.size() / (threads * 4), 1);
+        struct Chunk {
+            size_t first, last;
+            bool split;
+        };
+        std::vector<Chunk> chunks;
+        for (size_t i = 0, bytes = 0; i < lines.size(); ++i) {
+            if (threads > 1 && lines[i].size() >= SPLIT_LINE_BYTES) {
+                chunks.push_back({i, i + 1, true});
+                bytes = 0;
+                continue;
+            }
+            if (bytes == 0) {
+                chunks.push_back({i, i, false});
+            }
+            chunks.back().last = i + 1;
+            bytes += lines[i].size();
+            if (bytes >= chunkBytes) {
+                bytes = 0;
+            }
+        }
 
-            if (type == "SET") {
-                loadSet(name, data);
-            } else if (type == "HASH") {
-                loadHash(name, data);
-            } else if (type == "STACK") {
-                loadStack(name, data);
-            } else if (type == "QUEUE") {
-                loadQueue(name, data);
+        std::vector<LoadedPart> parts(chunks.size());
+        std::vector<size_t> ordinary;
+        for (size_t c = 0; c < chunks.size(); ++c) {
+            if (!chunks[c].split) {
+                ordinary.push_back(c);
+            }
+        }
+        runParallel(threads, ordinary.size(), [&](size_t task) {
+            const Chunk& chunk = chunks[ordinary[task]];
+            for (size_t i = chunk.first; i < chunk.last; ++i) {
+                parseLine(lines[i], parts[ordinary[task]]);
+            }
+        });
+        for (size_t c = 0; c < chunks.size(); ++c) {
+            if (chunks[c].split) {
+                parseLongLine(lines[chunks[c].first], threads, parts[c]);
             }
         }
 
-        file.close();
+        for (LoadedPart& part : parts) {
+            merge(part);
+        }
+        applyFilters(parts);
     }
 
-    void save() {
-        std::ofstream file(filename);
+    void saveText(const std::string& path) const {
+        std::string temp = FileUtils::tempPathFor(path);
+        std::ofstream file(temp);
         if (!file.is_open()) {
-            throw std::runtime_error("Cannot open file for writing: " + filename);
+            throw std::runtime_error("Cannot open file for writing: " + temp);
         }
 
         file << "# СУБД Data File\n";
-        file << "# Format: name:type|data\n\n";
+        file << "# Format: name:type|data\n";
+        if (logSequence > 0) {
+            file << LOG_SEQUENCE_TAG << logSequence << "\n";
+        }
+        file << "\n";
 
-        for (const auto& [name, hash] : hashes) {
-            file << name << ":HASH|";
-            savePairs(file, hash);
-            file << "\n";
+        keyspace.forEach([&file](const std::string& name, const std::unique_ptr<Object>& object) {
+            std::visit([&](const auto& structure) { writeLine(file, name, structure); }, *object);
+        });
+
+        file.close();
+        if (file.fail()) {
+            std::remove(temp.c_str());
+            throw std::runtime_error("Cannot write file: " + temp);
         }
+        FileUtils::replaceFile(temp, path);
+    }
+
+    // сумма проверяется до разбора: испорченный файл не загружается
+    // даже частично. Записи по оглавлению делятся между потоками
+    // примерно поровну по байтам, число элементов записи сразу задает
+    // размер контейнера
+    void loadBinary(const std::string& path) {
+        snapshot::Image image(path, snapshot::valueTag<T>());
+        logSequence = image.logSequence();
 
-        for (const auto& [name, set] : sets) {
-            file << name << ":SET|";
-            saveElements(file, set);
-            file << "\n";
+        size_t threads = loadThreads(FileUtils::fileSize(path));
+        size_t total = 0;
+        for (size_t r = 0; r < image.records(); ++r) {
+            total += image.record(r).raw.size();
         }
+        size_t chunkBytes = std::max<size_t>(total / (threads * 4), 1);
 
-        for (const auto& [name, stack] : stacks) {
-            file << name << ":STACK|";
-            saveElements(file, stack);
-            file << "\n";
+        std::vector<std::pair<size_t, size_t>> chunks;
+        for (size_t r = 0, bytes = 0; r < image.records(); ++r) {
+            if (bytes == 0) {
+                chunks.emplace_back(r, r);
+            }
+            chunks.back().second = r + 1;
+            bytes += image.record(r).raw.size();
+            if (bytes >= chunkBytes) {
+                bytes = 0;
+            }
         }
 
-        for (const auto& [name, queue] : queues) {
-            file << name << ":QUEUE|";
-            saveElements(file, queue);
-            file << "\n";
+        std::vector<LoadedPart> parts(chunks.size());
+        runParallel(threads, chunks.size(), [&](size_t c) {
+            for (size_t r = chunks[c].first; r < chunks[c].second; ++r) {
+                loadRecord(image.record(r), parts[c]);
+            }
+        });
+
+        for (LoadedPart& part : parts) {
+            merge(part);
         }
+        applyFilters(parts);
+    }
 
-        file.close();
+    static void loadRecord(snapshot::Record record, LoadedPart& part) {
+        snapshot::Reader& in = record.body;
+        std::string name(record.name);
+        uint64_t count = record.count;
+        int capacity = static_cast<int>(std::min<uint64_t>(count, INT32_MAX));
+
+        switch (record.kind) {
+            case snapshot::Kind::Hash: {
+                Hash& hash = part.template add<Hash>(name, capacity);
+                for (uint64_t i = 0; i < count; ++i) {
+                    std::string_view key = in.getString();
+                    hash.emplace(key, in.getValue<T>(record.valueTag));
+                }
+                break;
+            }
+            case snapshot::Kind::Set: {
+                Set<T>& set = part.template add<Set<T>>(name, capacity);
+                for (uint64_t i = 0; i < count; ++i) {
+                    set.insert(in.getValue<T>(record.valueTag));
+                }
+                double fpr = in.get<double>();
+                if (fpr > 0.0) {
+                    part.filters.emplace_back(std::move(name), fpr);
+                }
+                break;
+            }
+            case snapshot::Kind::Stack: {
+                Stack<T>& stack = part.template add<Stack<T>>(name);
+                for (uint64_t i = 0; i < count; ++i) {
+                    stack.push(in.getValue<T>(record.valueTag));
+                }
+                break;
+            }
+            case snapshot::Kind::Queue: {
+                myQueue<T>& queue = part.template add<myQueue<T>>(name);
+                queue.reserve(capacity);
+                for (uint64_t i = 0; i < count; ++i) {
+                    queue.push(in.getValue<T>(record.valueTag));
+                }
+                break;
+            }
+            default:
+                throw std::runtime_error("Unknown record in snapshot");
+        }
     }
 
- private:
-    std::string filename;
+    // пишется во временный файл рядом и подменяет прежний: отображение
+    // прежнего снимка, из которого копируются записи, остается целым,
+    // а сбой посреди записи не портит файл на диске
+    void saveBinary(const std::string& path, const snapshot::Image* previous) const {
+        std::map<std::pair<snapshot::Kind, std::string_view>, std::string_view> reusable;
+        for (size_t r = 0; previous && r < previous->records(); ++r) {
+            snapshot::Record record = previous->record(r);
+            if (dirty.count({record.kind, std::string(record.name)}) == 0) {
+                reusable.emplace(std::make_pair(record.kind, record.name), record.raw);
+            }
+        }
 
-    std::map<std::string, Set<T>> sets;
-    std::map<std::string, Stack<T>> stacks;
-    std::map<std::string, myQueue<T>> queues;
-    std::map<std::string, HashTableOA<std::string, T>> hashes;
+        std::string temp = FileUtils::tempPathFor(path);
+        snapshot::Writer out(temp);
+        out.put<uint32_t>(snapshot::valueTag<T>());
+        out.put<uint64_t>(logSequence);
+        out.put<uint64_t>(keyspace.getSize());
 
-    void loadSet(const std::string& name, const std::string& data) {
-        sets[name] = Set<T>();
-        std::vector<std::string> elements = StringUtils::split(data, '|');
-        for (const auto& elem : elements) {
-            if (!elem.empty()) {
-                sets[name].insert(StringUtils::parseValue<T>(elem));
+        keyspace.forEach([&](const std::string& name, const std::unique_ptr<Object>& object) {
+            auto it = reusable.find({kindOf(*object), std::string_view(name)});
+            if (it != reusable.end()) {
+                out.copyRecord(it->second);
+                return;
             }
+            std::visit([&](const auto& structure) { writeRecord(out, name, structure); }, *object);
+        });
+
+        out.finish();
+        FileUtils::replaceFile(temp, path);
+    }
+
+    // файл больше этого грузится несколькими потоками
+    static const size_t PARALLEL_LOAD_BYTES = 4 << 20;
+    // строка текстового файла длиннее этого разбирается по частям
+    static const size_t SPLIT_LINE_BYTES = 1 << 20;
+
+    static size_t loadThreads(size_t fileBytes) {
+        size_t threads = std::thread::hardware_concurrency();
+        if (threads <= 1 || fileBytes < PARALLEL_LOAD_BYTES) {
+            return 1;
         }
+        return std::min(threads, fileBytes / (PARALLEL_LOAD_BYTES / 4));
     }
 
-    void loadHash(const std::string& name, const std::string& data) {
-        if (hashes.find(name) == hashes.end()) {
-            hashes.emplace(name, HashTableOA<std::string, T>(1000));
+    // fn(задача) для задач [0, tasks) на threads потоках; задачи
+    // раздаются по счетчику, исключение первого упавшего потока
+    // пробрасывается вызывающему
+    template <typename Fn>
+    static void runParallel(size_t threads, size_t tasks, Fn&& fn) {
+        threads = std::min(threads, tasks);
+        if (threads <= 1) {
+            for (size_t task = 0; task < tasks; ++task) {
+                fn(task);
+            }
+            return;
         }
 
-        if (data.empty()) return;
+        std::atomic<size_t> next{0};
+        std::vector<std::exception_ptr> errors(threads);
+        auto work = [&](size_t worker) {
+            try {
+                for (size_t task = next++; task < tasks; task = next++) {
+                    fn(task);
+                }
+            } catch (...) {
+                errors[worker] = std::current_exception();
+                next = tasks;
+            }
+        };
 
-        std::vector<std::string> pairs = StringUtils::split(data, '|');
-        for (const auto& pair : pairs) {
-            if (pair.empty()) continue;
-            size_t colonPos = pair.find(':');
-            if (colonPos != std::string::npos) {
-                std::string key = pair.substr(0, colonPos);
-                std::string valueStr = pair.substr(colonPos + 1);
-                T value = StringUtils::parseValue<T>(valueStr);
-                hashes[name].insert(key, value);
+        std::vector<std::thread> workers;
+        for (size_t worker = 1; worker < threads; ++worker) {
+            workers.emplace_back(work, worker);
+        }
+        work(0);
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        for (auto& error : errors) {
+            if (error) {
+                std::rethrow_exception(error);
             }
         }
     }
 
-    void loadStack(const std::string& name, const std::string& data) {
-        stacks[name] = Stack<T>();
-        std::vector<std::string> elements = StringUtils::split(data, '|');
+    // ключ, встреченный в файле повторно, берется из последней записи
+    void merge(LoadedPart& part) {
+        for (auto& [name, object] : part.objects) {
+            keyspace.insert(std::move(name), std::move(object));
+        }
+    }
 
-        // в обратном порядке
-        for (int i = elements.size() - 1; i >= 0; --i) {
-            if (!elements[i].empty()) {
-                stacks[name].push(StringUtils::parseValue<T>(elements[i]));
+    // фильтр строится по уже собранному множеству, поэтому после слияния
+    void applyFilters(const std::vector<LoadedPart>& parts) {
+        for (const LoadedPart& part : parts) {
+            for (const auto& [name, fpr] : part.filters) {
+                std::unique_ptr<Object>* object = keyspace.get(name);
+                Set<T>* set = object ? std::get_if<Set<T>>(object->get()) : nullptr;
+                if (set && fpr > 0.0) {
+                    set->enableFilter(fpr);
+                }
             }
         }
     }
 
-    void loadQueue(const std::string& name, const std::string& data) {
-        queues[name] = myQueue<T>();
-        std::vector<std::string> elements = StringUtils::split(data, '|');
-        for (const auto& elem : elements) {
-            if (!elem.empty()) {
-                queues[name].push(StringUtils::parseValue<T>(elem));
+    // fn(поле) для непустых полей между '|'
+    template <typename Fn>
+    static void forEachField(std::string_view data, Fn&& fn) {
+        for (size_t begin = 0; begin < data.size();) {
+            size_t end = std::min(data.find('|', begin), data.size());
+            if (end > begin) {
+                fn(data.substr(begin, end - begin));
+            }
+            begin = end + 1;
+        }
+    }
+
+    static T parseField(std::string_view field) {
+        return StringUtils::parseValue<T>(std::string(field));
+    }
+
+    // "ключ:значение"; поле без ':' пропускается
+    static bool parsePair(std::string_view field, std::string& key, T& value) {
+        size_t colon = field.find(':');
+        if (colon == std::string_view::npos) {
+            return false;
+        }
+        key.assign(field.substr(0, colon));
+        value = parseField(field.substr(colon + 1));
+        return true;
+    }
+
+    // "name:TYPE|data"
+    static bool splitLine(std::string_view line, std::string_view& name, std::string_view& type,
+                          std::string_view& data) {
+        size_t colon = line.find(':');
+        size_t pipe = line.find('|');
+        if (colon == std::string_view::npos || pipe == std::string_view::npos || colon > pipe) {
+            return false;
+        }
+        name = line.substr(0, colon);
+        type = line.substr(colon + 1, pipe - colon - 1);
+        data = line.substr(pipe + 1);
+        return true;
+    }
+
+    static void parseLine(std::string_view line, LoadedPart& part) {
+        std::string_view name, type, data;
+        if (!splitLine(line, name, type, data)) {
+            return;
+        }
+        int capacity = static_cast<int>(std::count(data.begin(), data.end(), '|'));
+
+        if (type == "SET") {
+            Set<T>& set = part.template add<Set<T>>(name, capacity);
+            forEachField(data, [&set](std::string_view field) { set.insert(parseField(field)); });
+        } else if (type == "HASH") {
+            Hash& hash = part.template add<Hash>(name, capacity);
+            std::string key;
+            T value;
+            forEachField(data, [&](std::string_view field) {
+                if (parsePair(field, key, value)) {
+                    hash.insert(std::move(key), std::move(value));
+                }
+            });
+        } else if (type == "STACK") {
+            // в файле вершина идет первой
+            std::vector<T> values;
+            values.reserve(capacity);
+            forEachField(data, [&values](std::string_view field) {
+                values.push_back(parseField(field));
+            });
+            part.template add<Stack<T>>(name).pushRange(
+                std::make_move_iterator(values.rbegin()), std::make_move_iterator(values.rend()));
+        } else if (type == "QUEUE") {
+            myQueue<T>& queue = part.template add<myQueue<T>>(name);
+            queue.reserve(capacity);
+            forEachField(data, [&queue](std::string_view field) { queue.push(parseField(field)); });
+        } else if (type == "BLOOM") {
+            // запись BLOOM идет сразу после своего множества
+            forEachField(data.substr(0, data.find('|')), [&](std::string_view field) {
+                part.filters.emplace_back(name, StringUtils::parseValue<float>(std::string(field)));
+            });
+        }
+    }
+
+    // одна большая структура: данные режутся по '|' на куски, куски
+    // разбираются параллельно в массивы, а контейнер строится из них
+    // по порядку одним потоком
+    static void parseLongLine(std::string_view line, size_t threads, LoadedPart& part) {
+        std::string_view name, type, data;
+        if (!splitLine(line, name, type, data)) {
+            return;
+        }
+        if (type != "SET" && type != "HASH" && type != "STACK" && type != "QUEUE") {
+            parseLine(line, part);
+            return;
+        }
+
+        std::vector<std::string_view> pieces;
+        size_t pieceBytes = data.size() / (threads * 4) + 1;
+        for (size_t begin = 0; begin < data.size();) {
+            size_t end = data.find('|', std::min(begin + pieceBytes, data.size()) - 1);
+            end = end == std::string_view::npos ? data.size() : end + 1;
+            pieces.push_back(data.substr(begin, end - begin));
+            begin = end;
+        }
+
+        size_t total = 0;
+        if (type == "HASH") {
+            std::vector<std::vector<std::pair<std::string, T>>> parsed(pieces.size());
+            runParallel(threads, pieces.size(), [&](size_t p) {
+                std::string key;
+                T value;
+                forEachField(pieces[p], [&](std::string_view field) {
+                    if (parsePair(field, key, value)) {
+                        parsed[p].emplace_back(std::move(key), std::move(value));
+                    }
+                });
+            });
+            for (const auto& chunk : parsed) {
+                total += chunk.size();
+            }
+            Hash& hash = part.template add<Hash>(name, static_cast<int>(total));
+            for (auto& chunk : parsed) {
+                for (auto& [key, value] : chunk) {
+                    hash.insert(std::move(key), std::move(value));
+                }
+            }
+            return;
+        }
+
+        std::vector<std::vector<T>> parsed(pieces.size());
+        runParallel(threads, pieces.size(), [&](size_t p) {
+            forEachField(pieces[p], [&](std::string_view field) {
+                parsed[p].push_back(parseField(field));
+            });
+        });
+        for (const auto& chunk : parsed) {
+            total += chunk.size();
+        }
+
+        if (type == "SET") {
+            Set<T>& set = part.template add<Set<T>>(name, static_cast<int>(total));
+            for (auto& chunk : parsed) {
+                for (T& value : chunk) {
+                    set.insert(std::move(value));
+                }
+            }
+        } else if (type == "STACK") {
+            Stack<T>& stack = part.template add<Stack<T>>(name);
+            for (auto chunk = parsed.rbegin(); chunk != parsed.rend(); ++chunk) {
+                stack.pushRange(std::make_move_iterator(chunk->rbegin()),
+                                std::make_move_iterator(chunk->rend()));
+            }
+        } else {
+            myQueue<T>& queue = part.template add<myQueue<T>>(name);
+            queue.reserve(static_cast<int>(total));
+            for (auto& chunk : parsed) {
+                queue.pushRange(std::make_move_iterator(chunk.begin()),
+                                std::make_move_iterator(chunk.end()));
             }
         }
     }
 
-    // вспомогательные методы для сохранения
-    void savePairs(std::ostream& out, const HashTableOA<std::string, T>& hash) const {
+    // пересечение больших множеств делится между потоками по частям таблицы
+    static size_t intersectPartitions(size_t smallestSize) {
+        const size_t minPerPart = 1 << 15;
+        size_t threads = std::thread::hardware_concurrency();
+        if (threads <= 1 || smallestSize < 2 * minPerPart) {
+            return 1;
+        }
+        return std::min(threads, smallestSize / minPerPart);
+    }
+
+    // строка текстового файла для одной структуры
+    static void writeLine(std::ostream& out, const std::string& name, const Hash& hash) {
+        out << name << ":HASH|";
         hash.savePairsToStream(out);
+        out << "\n";
     }
 
-    void saveElements(std::ostream& out, const Set<T>& set) const {
+    static void writeLine(std::ostream& out, const std::string& name, const Set<T>& set) {
+        out << name << ":SET|";
         set.saveElementsToStream(out);
+        out << "\n";
+        // сам фильтр не сохраняется: при загрузке он строится заново
+        if (set.hasFilter()) {
+            out << name << ":BLOOM|" << set.filterStats().targetFpr << "|\n";
+        }
     }
 
-    void saveElements(std::ostream& out, const Stack<T>& stack) const {
+    static void writeLine(std::ostream& out, const std::string& name, const Stack<T>& stack) {
+        out << name << ":STACK|";
         stack.saveElementsToStream(out);
+        out << "\n";
     }
 
-    void saveElements(std::ostream& out, const myQueue<T>& queue) const {
+    static void writeLine(std::ostream& out, const std::string& name, const myQueue<T>& queue) {
+        out << name << ":QUEUE|";
         queue.saveElementsToStream(out);
+        out << "\n";
+    }
+
+    // запись двоичного снимка для одной структуры
+    static void writeRecord(snapshot::Writer& out, const std::string& name, const Hash& hash) {
+        out.beginRecord(snapshot::Kind::Hash, name, hash.getSize());
+        hash.forEach([&out](const std::string& key, const T& value) {
+            out.putString(key);
+            out.putValue(value);
+        });
+    }
+
+    static void writeRecord(snapshot::Writer& out, const std::string& name, const Set<T>& set) {
+        out.beginRecord(snapshot::Kind::Set, name, set.size());
+        set.forEach([&out](const T& value) { out.putValue(value); });
+        out.put<double>(set.hasFilter() ? set.filterStats().targetFpr : 0.0);
+    }
+
+    static void writeRecord(snapshot::Writer& out, const std::string& name,
+                            const Stack<T>& stack) {
+        out.beginRecord(snapshot::Kind::Stack, name, stack.getSize());
+        stack.forEach([&out](const T& value) { out.putValue(value); });
+    }
+
+    static void writeRecord(snapshot::Writer& out, const std::string& name,
+                            const myQueue<T>& queue) {
+        out.beginRecord(snapshot::Kind::Queue, name, queue.getSize());
+        queue.forEach([&out](const T& value) { out.putValue(value); });
     }
 };
@@ -0,0 +1,206 @@
+// Copyright message
+#pragma once
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <string>
+#include "./AppendLog.hpp"
+#include "./CommandParser.hpp"
+#include "./Database.hpp"
+
+struct PersistenceOptions {
+    SnapshotFormat format = SnapshotFormat::Binary;
+    bool appendOnly = false;
+    FsyncPolicy fsync = FsyncPolicy::Interval;
+    int fsyncIntervalMs = 1000;
+    int saveInterval = 1;            // без журнала: секунд между снимками
+    double rewriteRatio = 1.0;       // журнал больше снимка во столько раз - переписать
+    size_t rewriteMinBytes = 1 << 20;
+    bool background = false;         // снимки пишет дочерний процесс (сервер)
+};
+
+// как изменения попадают на диск. Без журнала база целиком
+// сохраняется не чаще раза в saveInterval секунд. С журналом каждая
+// изменяющая команда дописывается в <файл>.aof, при старте снимок
+// загружается и журнал воспроизводится поверх него, а когда журнал
+// перерастает снимок, пишется новый снимок и журнал начинается заново.
+// С background снимки пишет дочерний процесс, и сервер не ждет записи
+template <typename T>
+class Persistence {
+ public:
+    using Clock = std::chrono::steady_clock;
+
+    Persistence(Database<T>& db, CommandParser<T>& parser, PersistenceOptions options)
+        : db(db), parser(parser), options(options),
+          logPath(db.getFilename() + ".aof"), lastSave(Clock::now()) {
+        db.setFormat(options.format);
+    }
+
+    void open() {
+        db.load();
+
+        // записи до номера из снимка в нем уже учтены
+        sequence = db.getLogSequence();
+        size_t replayed = 0;
+        AppendLog::replay(logPath, [&](uint64_t number, const std::string& command) {
+            if (number > sequence) {
+                parser.execute(command);
+                sequence = number;
+                replayed++;
+            }
+        });
+
+        if (options.appendOnly) {
+            log = std::make_unique<AppendLog>(logPath, options.fsync, options.fsyncIntervalMs);
+            snapshotBytes = FileUtils::fileSize(db.getFilename());
+        } else if (replayed > 0) {
+            // журнал остался от запуска с --appendonly: его изменения
+            // переносятся в снимок, иначе они потерялись бы
+            rewrite();
+            std::remove(logPath.c_str());
+        }
+    }
+
+    // после успешно выполненной команды; чтение ничего не меняет
+    void record(const std::string& command, const std::string& line) {
+        if (!CommandParser<T>::isWriteCommand(StringUtils::toLower(command))) {
+            return;
+        }
+
+        if (!log) {
+            dirty = true;
+            return;
+        }
+        log->append(++sequence, line);
+        if (log->size() >= std::max(options.rewriteMinBytes,
+                static_cast<size_t>(snapshotBytes * options.rewriteRatio))) {
+            snapshotNow();
+        }
+    }
+
+    // периодическая работа: итог фоновой записи, fsync журнала
+    // или отложенное сохранение
+    void tick() {
+        reapChild(false);
+        if (log) {
+            log->syncIfDue();
+        } else if (dirty && Clock::now() - lastSave >= std::chrono::seconds(options.saveInterval)) {
+            snapshotNow();
+        }
+    }
+
+    // через сколько миллисекунд нужен tick(), -1 - не нужен
+    int msUntilDue() const {
+        int timeout = child > 0 ? CHILD_POLL_MS : -1;
+        int due = -1;
+        if (log) {
+            due = log->msUntilSync();
+        } else if (dirty && child <= 0) {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                lastSave + std::chrono::seconds(options.saveInterval) - Clock::now());
+            due = static_cast<int>(std::max<long long>(0, left.count()));
+        }
+        return timeout < 0 ? due : due < 0 ? timeout : std::min(timeout, due);
+    }
+
+    // при остановке: все принятые изменения должны быть на диске
+    void flush() {
+        reapChild(true);
+        if (log) {
+            if (options.fsync != FsyncPolicy::No) {
+                log->sync();
+            }
+        } else if (dirty) {
+            rewrite();
+        }
+    }
+
+    // BGSAVE: снимок в фоне, если разрешено, иначе сразу;
+    // false - фоновая запись уже идет
+    bool snapshotNow() {
+        if (child > 0) {
+            return false;
+        }
+        if (options.background) {
+            startChild();
+        } else {
+            rewrite();
+        }
+        return true;
+    }
+
+    // новый снимок с номером последней записи, затем пустой журнал;
+    // сбой между этими шагами не страшен - лишние записи отсеются по номеру
+    void rewrite() {
+        reapChild(true);
+        db.setLogSequence(sequence);
+        db.save();
+        if (log) {
+            log->truncate();
+        }
+        snapshotWritten();
+    }
+
+ private:
+    static const int CHILD_POLL_MS = 50;
+
+    Database<T>& db;
+    CommandParser<T>& parser;
+    PersistenceOptions options;
+    std::string logPath;
+    std::unique_ptr<AppendLog> log;
+    uint64_t sequence = 0;
+    size_t snapshotBytes = 0;
+    bool dirty = false;
+    Clock::time_point lastSave;
+
+    pid_t child = -1;      // процесс фоновой записи
+    size_t logMark = 0;    // длина журнала на момент fork
+
+    // журнал продолжает писаться, пока потомок пишет снимок; записи
+    // до logMark войдут в снимок и потом отрезаются
+    void startChild() {
+        db.setLogSequence(sequence);
+        logMark = log ? log->size() : 0;
+        child = db.saveInBackground();
+        dirty = false;
+        lastSave = Clock::now();
+    }
+
+    void reapChild(bool wait) {
+        if (child <= 0) {
+            return;
+        }
+        int status = 0;
+        pid_t done = waitpid(child, &status, wait ? 0 : WNOHANG);
+        if (done == 0 || (done < 0 && errno == EINTR)) {
+            return;
+        }
+        child = -1;
+
+        bool saved = done > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+        db.finishBackgroundSave(saved);
+        if (!saved) {
+            std::cerr << "Background save failed, will retry" << std::endl;
+            dirty = !log;
+            return;
+        }
+        if (log) {
+            log->discardBefore(logMark);
+        }
+        snapshotWritten();
+    }
+
+    void snapshotWritten() {
+        dirty = false;
+        lastSave = Clock::now();
+        snapshotBytes = FileUtils::fileSize(db.getFilename());
+    }
+};
@@ -0,0 +1,448 @@
+// Copyright message
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <charconv>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#include "../containers/Hashers.hpp"
+#include "./Value.hpp"
+
+// в каком виде база пишется на диск; читаются оба, вид определяется
+// по первым байтам файла
+enum class SnapshotFormat {
+    Text,    // name:TYPE|a|b|... - для импорта, экспорта и правки руками
+    Binary   // snapshot:: ниже - для быстрого старта
+};
+
+inline SnapshotFormat parseSnapshotFormat(const std::string& name) {
+    if (name == "text") return SnapshotFormat::Text;
+    if (name == "binary") return SnapshotFormat::Binary;
+    throw std::runtime_error("Unknown snapshot format: '" + name + "' (text, binary)");
+}
+
+// двоичный снимок:
+//   заголовок  "DBMSSNAP", версия, метка порядка байт, тип значений,
+//              номер записи журнала, число записей
+//   запись     вид (u8), имя, число элементов (u64), элементы
+//   оглавление смещения начала записей (u64 каждое), затем смещение
+//              самого оглавления (u64)
+//   хвост      контрольная сумма всего, что перед ней (u64)
+// Строки - u32 длина и байты, int и float - как в памяти, 4 байта,
+// Value - тип (u8), затем i64, f64 или строка.
+// Числа пишутся в порядке байт машины: файл с чужим порядком
+// распознается по метке и отвергается. По оглавлению запись находится
+// без разбора предыдущих, и неизмененная запись переносится в новый
+// снимок простым копированием байт
+namespace snapshot {
+
+const char MAGIC[8] = {'D', 'B', 'M', 'S', 'S', 'N', 'A', 'P'};
+const uint32_t VERSION = 2;
+const uint32_t BYTE_ORDER_MARK = 0x01020304;
+// сумма считается цепочкой wyhash по блокам, писатель и читатель
+// режут файл на одинаковые блоки
+const size_t CHECKSUM_BLOCK = 1 << 16;
+
+enum class Kind : uint8_t {
+    Hash = 1,
+    Set = 2,     // после элементов - f64 вероятность ошибки фильтра, 0 - без фильтра
+    Stack = 3,   // от дна к вершине
+    Queue = 4    // от головы к хвосту
+};
+
+template <typename T>
+constexpr uint32_t valueTag() {
+    static_assert(std::is_same_v<T, std::string> || std::is_same_v<T, int>
+                  || std::is_same_v<T, float> || std::is_same_v<T, Value>,
+                  "no binary encoding for this type");
+    static_assert(sizeof(int) == 4 && sizeof(float) == 4, "4-byte int and float expected");
+    if constexpr (std::is_same_v<T, std::string>) {
+        return 1;
+    } else if constexpr (std::is_same_v<T, int>) {
+        return 2;
+    } else if constexpr (std::is_same_v<T, float>) {
+        return 3;
+    } else {
+        return 4;
+    }
+}
+
+// снимок однотипной базы (string, int, float) читается и базой
+// со значениями Value: каждое значение переводится при загрузке
+inline bool canRead(uint32_t stored, uint32_t wanted) {
+    return stored == wanted || wanted == valueTag<Value>();
+}
+
+inline uint64_t checksum(const char* data, size_t size) {
+    uint64_t sum = 0;
+    for (size_t pos = 0; pos < size; pos += CHECKSUM_BLOCK) {
+        size_t length = std::min(CHECKSUM_BLOCK, size - pos);
+        sum = WyHasher()(std::string_view(data + pos, length), sum);
+    }
+    return sum;
+}
+
+// по чему видно, что файл не меняли со времени нашей записи или чтения
+struct FileStamp {
+    dev_t device = 0;
+    ino_t inode = 0;
+    off_t size = -1;
+    timespec modified{};
+
+    static FileStamp of(const std::string& path) {
+        FileStamp stamp;
+        struct stat st;
+        if (stat(path.c_str(), &st) == 0) {
+            stamp.device = st.st_dev;
+            stamp.inode = st.st_ino;
+            stamp.size = st.st_size;
+            stamp.modified = st.st_mtim;
+        }
+        return stamp;
+    }
+
+    bool exists() const {
+        return size >= 0;
+    }
+
+    bool operator==(const FileStamp& other) const {
+        return device == other.device && inode == other.inode && size == other.size
+            && modified.tv_sec == other.modified.tv_sec
+            && modified.tv_nsec == other.modified.tv_nsec;
+    }
+};
+
+inline bool isSnapshot(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    char head[sizeof(MAGIC)];
+    return file.read(head, sizeof(head)) && std::memcmp(head, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+// буферизованная запись; сумма считается по мере сброса полных блоков
+class Writer {
+ public:
+    explicit Writer(const std::string& path)
+        : path(path), file(path, std::ios::binary | std::ios::trunc) {
+        if (!file.is_open()) {
+            throw std::runtime_error("Cannot open file for writing: " + path);
+        }
+        append(MAGIC, sizeof(MAGIC));
+        put<uint32_t>(VERSION);
+        put<uint32_t>(BYTE_ORDER_MARK);
+    }
+
+    template <typename N>
+    void put(N value) {
+        static_assert(std::is_arithmetic_v<N>);
+        append(&value, sizeof(value));
+    }
+
+    void putString(std::string_view value) {
+        if (value.size() > UINT32_MAX) {
+            throw std::runtime_error("Element too long for snapshot: " + path);
+        }
+        put<uint32_t>(static_cast<uint32_t>(value.size()));
+        append(value.data(), value.size());
+    }
+
+    template <typename T>
+    void putValue(const T& value) {
+        if constexpr (std::is_same_v<T, std::string>) {
+            putString(value);
+        } else if constexpr (std::is_same_v<T, Value>) {
+            put<uint8_t>(static_cast<uint8_t>(value.type()));
+            switch (value.type()) {
+                case Value::Type::Int: put<int64_t>(value.asInt()); break;
+                case Value::Type::Float: put<double>(value.asFloat()); break;
+                default: putString(value.asString()); break;
+            }
+        } else {
+            put<T>(value);
+        }
+    }
+
+    void beginRecord(Kind kind, std::string_view name, uint64_t count) {
+        offsets.push_back(written);
+        put<uint8_t>(static_cast<uint8_t>(kind));
+        putString(name);
+        put<uint64_t>(count);
+    }
+
+    // запись целиком, как она лежала в прежнем снимке
+    void copyRecord(std::string_view raw) {
+        offsets.push_back(written);
+        append(raw.data(), raw.size());
+    }
+
+    void finish() {
+        uint64_t indexOffset = written;
+        for (uint64_t offset : offsets) {
+            put<uint64_t>(offset);
+        }
+        put<uint64_t>(indexOffset);
+        flushBlocks(true);
+        file.write(reinterpret_cast<const char*>(&sum), sizeof(sum));
+        file.close();
+        if (file.fail()) {
+            throw std::runtime_error("Cannot write file: " + path);
+        }
+    }
+
+ private:
+    std::string path;
+    std::ofstream file;
+    std::string buffer;
+    std::vector<uint64_t> offsets;
+    uint64_t written = 0;
+    uint64_t sum = 0;
+
+    void append(const void* data, size_t size) {
+        buffer.append(static_cast<const char*>(data), size);
+        written += size;
+        if (buffer.size() >= 16 * CHECKSUM_BLOCK) {
+            flushBlocks(false);
+        }
+    }
+
+    void flushBlocks(bool all) {
+        size_t length = all ? buffer.size() : buffer.size() / CHECKSUM_BLOCK * CHECKSUM_BLOCK;
+        for (size_t pos = 0; pos < length; pos += CHECKSUM_BLOCK) {
+            size_t block = std::min(CHECKSUM_BLOCK, length - pos);
+            sum = WyHasher()(std::string_view(buffer.data() + pos, block), sum);
+        }
+        file.write(buffer.data(), static_cast<std::streamsize>(length));
+        buffer.erase(0, length);
+    }
+};
+
+// файл целиком отображается в память и читается по указателю:
+// строки отдаются как string_view прямо в отображение
+class MappedFile {
+ public:
+    explicit MappedFile(const std::string& path) {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw std::runtime_error("Cannot open " + path + ": " + std::strerror(errno));
+        }
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            length = static_cast<size_t>(st.st_size);
+            void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped != MAP_FAILED) {
+                data = static_cast<const char*>(mapped);
+                madvise(mapped, length, MADV_SEQUENTIAL);
+            }
+        }
+        close(fd);
+        if (!data && length > 0) {
+            throw std::runtime_error("Cannot map " + path + ": " + std::strerror(errno));
+        }
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+        if (data) {
+            munmap(const_cast<char*>(data), length);
+        }
+    }
+
+    const char* begin() const {
+        return data;
+    }
+
+    size_t size() const {
+        return length;
+    }
+
+ private:
+    const char* data = nullptr;
+    size_t length = 0;
+};
+
+// чтение с проверкой границ; сумма проверяется до разбора, поэтому
+// выход за границу означает ошибку в самом формате
+class Reader {
+ public:
+    Reader(const char* data, size_t size) : pos(data), end(data + size) {}
+
+    template <typename N>
+    N get() {
+        static_assert(std::is_arithmetic_v<N>);
+        need(sizeof(N));
+        N value;
+        std::memcpy(&value, pos, sizeof(N));
+        pos += sizeof(N);
+        return value;
+    }
+
+    std::string_view getString() {
+        uint32_t length = get<uint32_t>();
+        need(length);
+        std::string_view value(pos, length);
+        pos += length;
+        return value;
+    }
+
+    template <typename T>
+    T getValue() {
+        if constexpr (std::is_same_v<T, std::string>) {
+            return std::string(getString());
+        } else if constexpr (std::is_same_v<T, Value>) {
+            switch (static_cast<Value::Type>(get<uint8_t>())) {
+                case Value::Type::String: return Value(getString());
+                case Value::Type::Int: return Value(get<int64_t>());
+                case Value::Type::Float: return Value(get<double>());
+                default: throw std::runtime_error("Unknown value type in snapshot");
+            }
+        } else {
+            return get<T>();
+        }
+    }
+
+    // значение из снимка с типом значений stored (см. canRead)
+    template <typename T>
+    T getValue(uint32_t stored) {
+        if constexpr (std::is_same_v<T, Value>) {
+            if (stored == valueTag<std::string>()) {
+                return Value::parse(getString());
+            } else if (stored == valueTag<int>()) {
+                return Value(static_cast<int64_t>(get<int>()));
+            } else if (stored == valueTag<float>()) {
+                // кратчайшая запись float, а не его точное значение в double
+                char text[32];
+                auto out = std::to_chars(text, text + sizeof(text), get<float>());
+                return Value::parse(std::string_view(text, out.ptr - text));
+            }
+        }
+        (void)stored;
+        return getValue<T>();
+    }
+
+    void skip(size_t size) {
+        need(size);
+        pos += size;
+    }
+
+    size_t remaining() const {
+        return static_cast<size_t>(end - pos);
+    }
+
+ private:
+    const char* pos;
+    const char* end;
+
+    void need(size_t size) const {
+        if (static_cast<size_t>(end - pos) < size) {
+            throw std::runtime_error("Snapshot is truncated");
+        }
+    }
+};
+
+struct Record {
+    Kind kind;
+    std::string_view name;
+    uint64_t count;
+    Reader body;           // элементы
+    std::string_view raw;  // запись целиком, для копирования
+    uint32_t valueTag;     // тип значений снимка
+};
+
+// проверенный снимок в памяти: сумма и заголовок сверяются при открытии,
+// записи достаются по номеру через оглавление. Сумму можно не считать,
+// если файл уже проверялся и с тех пор не менялся
+class Image {
+ public:
+    // wanted - тип значений читающей базы, см. canRead
+    Image(const std::string& path, uint32_t wanted, bool verify = true) : file(path) {
+        const size_t trailer = 2 * sizeof(uint64_t);
+        if (file.size() < sizeof(MAGIC) + trailer) {
+            throw std::runtime_error("Snapshot is truncated: " + path);
+        }
+
+        size_t body = file.size() - sizeof(uint64_t);
+        uint64_t stored;
+        std::memcpy(&stored, file.begin() + body, sizeof(stored));
+        if (verify && checksum(file.begin(), body) != stored) {
+            throw std::runtime_error("Snapshot checksum mismatch: " + path);
+        }
+
+        Reader header(file.begin(), body);
+        header.skip(sizeof(MAGIC));
+        if (header.get<uint32_t>() != VERSION) {
+            throw std::runtime_error("Unsupported snapshot version: " + path);
+        }
+        if (header.get<uint32_t>() != BYTE_ORDER_MARK) {
+            throw std::runtime_error("Snapshot was written with another byte order: " + path);
+        }
+        tag = header.get<uint32_t>();
+        if (!canRead(tag, wanted)) {
+            throw std::runtime_error("Snapshot holds values of another type: " + path);
+        }
+        sequence = header.get<uint64_t>();
+        count = header.get<uint64_t>();
+        recordsBegin = body - header.remaining();
+
+        std::memcpy(&indexOffset, file.begin() + body - sizeof(uint64_t), sizeof(indexOffset));
+        if (indexOffset < recordsBegin || indexOffset > body - sizeof(uint64_t)
+                || (body - sizeof(uint64_t) - indexOffset) / sizeof(uint64_t) != count) {
+            throw std::runtime_error("Snapshot index is corrupted: " + path);
+        }
+    }
+
+    uint64_t logSequence() const {
+        return sequence;
+    }
+
+    size_t records() const {
+        return count;
+    }
+
+    Record record(size_t i) const {
+        uint64_t begin = offsetAt(i);
+        uint64_t end = i + 1 < count ? offsetAt(i + 1) : indexOffset;
+        if (begin < recordsBegin || begin > end || end > indexOffset) {
+            throw std::runtime_error("Snapshot index is corrupted");
+        }
+
+        std::string_view raw(file.begin() + begin, end - begin);
+        Reader in(raw.data(), raw.size());
+        Kind kind = static_cast<Kind>(in.get<uint8_t>());
+        std::string_view name = in.getString();
+        uint64_t elements = in.get<uint64_t>();
+        return {kind, name, elements, in, raw, tag};
+    }
+
+    uint32_t valueTag() const {
+        return tag;
+    }
+
+ private:
+    MappedFile file;
+    uint32_t tag = 0;
+    uint64_t sequence = 0;
+    size_t count = 0;
+    size_t recordsBegin = 0;
+    uint64_t indexOffset = 0;
+
+    uint64_t offsetAt(size_t i) const {
+        uint64_t offset;
+        std::memcpy(&offset, file.begin() + indexOffset + i * sizeof(uint64_t), sizeof(offset));
+        return offset;
+    }
+};
+
+}  // namespace snapshot
@@ -0,0 +1,260 @@
+// Copyright
+#pragma once
+
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include "../utils/StringUtils.hpp"
+
+// значение любого типа в 16 байтах: целое и вещественное лежат прямо
+// в объекте, строка до 15 байт - тоже, длинная строка - в куче.
+// Тип определяется по тексту на входе (команда, текстовый файл):
+// текст считается числом, только если число печатается обратно тем же
+// текстом, поэтому значение всегда выводится ровно так, как было введено,
+// а одинаковый текст всегда дает одинаковое значение
+class Value {
+ public:
+    enum class Type : uint8_t {
+        String = 0,  // нулевые байты - пустая строка
+        Int = 1,
+        Float = 2
+    };
+
+    static const size_t INLINE_CAPACITY = 15;
+
+    Value() {
+        std::memset(bytes, 0, sizeof(bytes));
+    }
+
+    explicit Value(int64_t number) : Value() {
+        std::memcpy(bytes, &number, sizeof(number));
+        bytes[META] = static_cast<uint8_t>(Type::Int);
+    }
+
+    explicit Value(double number) : Value() {
+        std::memcpy(bytes, &number, sizeof(number));
+        bytes[META] = static_cast<uint8_t>(Type::Float);
+    }
+
+    explicit Value(std::string_view text) : Value() {
+        assign(text);
+    }
+
+    Value(const Value& other) {
+        std::memcpy(bytes, other.bytes, sizeof(bytes));
+        if (other.onHeap()) {
+            bytes[META] = 0;
+            assign(other.asString());
+        }
+    }
+
+    // длинная строка передается вместе с указателем
+    Value(Value&& other) noexcept {
+        std::memcpy(bytes, other.bytes, sizeof(bytes));
+        std::memset(other.bytes, 0, sizeof(other.bytes));
+    }
+
+    Value& operator=(const Value& other) {
+        if (this != &other) {
+            Value copy(other);
+            swap(copy);
+        }
+        return *this;
+    }
+
+    Value& operator=(Value&& other) noexcept {
+        if (this != &other) {
+            release();
+            std::memcpy(bytes, other.bytes, sizeof(bytes));
+            std::memset(other.bytes, 0, sizeof(other.bytes));
+        }
+        return *this;
+    }
+
+    ~Value() {
+        release();
+    }
+
+    // разбор на входе: каноническое целое, каноническое конечное
+    // вещественное, иначе строка
+    static Value parse(std::string_view text) {
+        if (text.empty() || text.size() > MAX_NUMBER_CHARS
+                || !(text[0] == '-' || text[0] == '.' || (text[0] >= '0' && text[0] <= '9'))) {
+            return Value(text);
+        }
+
+        const char* end = text.data() + text.size();
+        char printed[MAX_NUMBER_CHARS + 8];
+
+        int64_t integer;
+        auto parsedInt = std::from_chars(text.data(), end, integer);
+        if (parsedInt.ec == std::errc() && parsedInt.ptr == end) {
+            auto out = std::to_chars(printed, printed + sizeof(printed), integer);
+            if (std::string_view(printed, out.ptr - printed) == text) {
+                return Value(integer);
+            }
+            return Value(text);  // "007", "-0"
+        }
+
+        double real;
+        auto parsedReal = std::from_chars(text.data(), end, real);
+        if (parsedReal.ec == std::errc() && parsedReal.ptr == end && std::isfinite(real)) {
+            auto out = std::to_chars(printed, printed + sizeof(printed), real);
+            if (std::string_view(printed, out.ptr - printed) == text) {
+                return Value(real);
+            }
+        }
+        return Value(text);
+    }
+
+    std::string toString() const {
+        switch (type()) {
+            case Type::Int:
+                return std::to_string(asInt());
+            case Type::Float: {
+                char printed[MAX_NUMBER_CHARS + 8];
+                auto out = std::to_chars(printed, printed + sizeof(printed), asFloat());
+                return std::string(printed, out.ptr - printed);
+            }
+            default:
+                return std::string(asString());
+        }
+    }
+
+    Type type() const {
+        return static_cast<Type>(bytes[META] & TYPE_MASK);
+    }
+
+    int64_t asInt() const {
+        int64_t number;
+        std::memcpy(&number, bytes, sizeof(number));
+        return number;
+    }
+
+    double asFloat() const {
+        double number;
+        std::memcpy(&number, bytes, sizeof(number));
+        return number;
+    }
+
+    // только для строки
+    std::string_view asString() const {
+        if (onHeap()) {
+            const char* block = heapBlock();
+            size_t length;
+            std::memcpy(&length, block, sizeof(length));
+            return std::string_view(block + sizeof(length), length);
+        }
+        return std::string_view(reinterpret_cast<const char*>(bytes), bytes[META] >> LENGTH_SHIFT);
+    }
+
+    // длина строки или размер числа - для порогов компактного представления
+    size_t byteSize() const {
+        return type() == Type::String ? asString().size() : sizeof(int64_t);
+    }
+
+    // память в куче помимо самого объекта
+    size_t heapBytes() const {
+        return onHeap() ? sizeof(size_t) + asString().size() : 0;
+    }
+
+    template <typename Hasher>
+    uint64_t hash(const Hasher& hasher, uint64_t seed) const {
+        if (type() == Type::String) {
+            return hasher(asString(), seed);
+        }
+        uint64_t payload;
+        std::memcpy(&payload, bytes, sizeof(payload));
+        return hasher(payload, seed + static_cast<uint64_t>(type()));
+    }
+
+    // значения разных типов не равны: одинаковый текст дает один тип
+    friend bool operator==(const Value& a, const Value& b) {
+        if (a.type() != b.type()) {
+            return false;
+        }
+        if (a.type() == Type::String) {
+            return a.asString() == b.asString();
+        }
+        return std::memcmp(a.bytes, b.bytes, sizeof(int64_t)) == 0;
+    }
+
+    friend bool operator!=(const Value& a, const Value& b) {
+        return !(a == b);
+    }
+
+    friend std::ostream& operator<<(std::ostream& out, const Value& value) {
+        return out << value.toString();
+    }
+
+    void swap(Value& other) noexcept {
+        unsigned char tmp[sizeof(bytes)];
+        std::memcpy(tmp, bytes, sizeof(bytes));
+        std::memcpy(bytes, other.bytes, sizeof(bytes));
+        std::memcpy(other.bytes, tmp, sizeof(bytes));
+    }
+
+ private:
+    // последний байт: тип в младших битах, признак строки в куче
+    // и длина короткой строки
+    static const size_t META = 15;
+    static const uint8_t TYPE_MASK = 0x03;
+    static const uint8_t HEAP_FLAG = 0x04;
+    static const int LENGTH_SHIFT = 3;
+    // самое длинное каноническое число: "-9223372036854775808", "-1.2345678901234567e-308"
+    static const size_t MAX_NUMBER_CHARS = 24;
+
+    alignas(8) unsigned char bytes[16];
+
+    bool onHeap() const {
+        return (bytes[META] & HEAP_FLAG) != 0;
+    }
+
+    const char* heapBlock() const {
+        const char* block;
+        std::memcpy(&block, bytes, sizeof(block));
+        return block;
+    }
+
+    // строка в пустой объект; длинная - блоком [длина][байты] в куче
+    void assign(std::string_view text) {
+        if (text.size() <= INLINE_CAPACITY) {
+            std::memcpy(bytes, text.data(), text.size());
+            bytes[META] = static_cast<uint8_t>(static_cast<uint8_t>(Type::String)
+                                               | (text.size() << LENGTH_SHIFT));
+            return;
+        }
+
+        size_t length = text.size();
+        char* block = static_cast<char*>(::operator new(sizeof(length) + length));
+        std::memcpy(block, &length, sizeof(length));
+        std::memcpy(block + sizeof(length), text.data(), length);
+        std::memcpy(bytes, &block, sizeof(block));
+        bytes[META] = static_cast<uint8_t>(static_cast<uint8_t>(Type::String) | HEAP_FLAG);
+    }
+
+    void release() {
+        if (onHeap()) {
+            ::operator delete(const_cast<char*>(heapBlock()));
+        }
+    }
+};
+
+inline size_t heapBytes(const Value& value) {
+    return value.heapBytes();
+}
+
+template<>
+inline Value StringUtils::parseValue<Value>(const std::string& s) {
+    return Value::parse(s);
+}
+
+template<>
+inline std::string StringUtils::toStringValue<Value>(const Value& v) {
+    return v.toString();
+}
@@ -0,0 +1,515 @@
+// Copyright message
+#pragma once
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "../database/CommandParser.hpp"
+#include "../database/Database.hpp"
+#include "../database/Persistence.hpp"
+#include "../utils/StringUtils.hpp"
+
+struct ServerOptions {
+    std::string socketPath;              // Unix-сокет; пусто - TCP
+    std::string bindAddress = "127.0.0.1";
+    int port = 6380;
+    size_t maxRequestBytes = 64 << 20;   // предел одной недочитанной строки
+};
+
+// сервер на одном потоке с неблокирующими сокетами и epoll: база
+// живет в памяти, команды приходят строками в том же синтаксисе, что
+// и --query, и могут идти пачкой без ожидания ответов (конвейер).
+// Ответ: "$<длина>\n<вывод>\n" при успехе, "-<ошибка>\n" при ошибке.
+// Изменения передаются в Persistence, которая сохраняет их в фоне
+// между событиями; при остановке по SIGINT/SIGTERM все доводится до диска
+template <typename T>
+class Server {
+ public:
+    using Clock = std::chrono::steady_clock;
+
+    Server(Database<T>& db, CommandParser<T>& parser, Persistence<T>& persistence,
+           ServerOptions options)
+        : db(db), parser(parser), persistence(persistence), options(std::move(options)) {
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        if (epollFd < 0) {
+            throw std::runtime_error(std::string("epoll_create1: ") + std::strerror(errno));
+        }
+        listenFd = this->options.socketPath.empty() ? listenTcp() : listenUnix();
+        watch(listenFd, EPOLLIN, EPOLL_CTL_ADD);
+    }
+
+    Server(const Server&) = delete;
+    Server& operator=(const Server&) = delete;
+
+    ~Server() {
+        while (!connections.empty()) {
+            closeConnection(connections.begin()->first);
+        }
+        if (listenFd >= 0) {
+            close(listenFd);
+        }
+        if (!options.socketPath.empty()) {
+            unlink(options.socketPath.c_str());
+        }
+        if (epollFd >= 0) {
+            close(epollFd);
+        }
+    }
+
+    // до сигнала остановки; перед выходом несохраненные изменения пишутся в файл
+    void run() {
+        installSignalHandlers();
+
+        std::vector<epoll_event> events(256);
+        while (!stopRequested) {
+            int ready = epoll_wait(epollFd, events.data(), static_cast<int>(events.size()),
+                                   nextTimeout());
+            if (ready < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::runtime_error(std::string("epoll_wait: ") + std::strerror(errno));
+            }
+
+            for (int i = 0; i < ready; ++i) {
+                int fd = events[i].data.fd;
+                if (fd == listenFd) {
+                    acceptAll();
+                } else {
+                    handleEvent(fd, events[i].events);
+                }
+            }
+
+            expireWaiters();
+            persistence.tick();
+        }
+
+        persistence.flush();
+    }
+
+ private:
+    struct Connection {
+        std::string in;
+        size_t inPos = 0;
+        std::string out;
+        size_t outPos = 0;
+        bool blocked = false;   // ждет в BQPOP, остальной конвейер стоит
+        bool closing = false;   // закрыть, когда ответы уйдут
+        bool writable = false;  // подписан ли на EPOLLOUT
+        bool eof = false;       // клиент закрыл свою сторону
+    };
+
+    // клиент, ждущий элемент очереди; timeout 0 - ждать без срока
+    struct Waiter {
+        int fd;
+        std::string queue;
+        bool forever;
+        Clock::time_point deadline;
+    };
+
+    Database<T>& db;
+    CommandParser<T>& parser;
+    Persistence<T>& persistence;
+    ServerOptions options;
+    int epollFd = -1;
+    int listenFd = -1;
+    std::map<int, Connection> connections;
+    std::deque<Waiter> waiters;
+    bool waking = false;
+
+    static inline volatile sig_atomic_t stopRequested = 0;
+
+    static void onSignal(int) {
+        stopRequested = 1;
+    }
+
+    // без SA_RESTART, чтобы сигнал прерывал epoll_wait
+    static void installSignalHandlers() {
+        struct sigaction action {};
+        action.sa_handler = onSignal;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGINT, &action, nullptr);
+        sigaction(SIGTERM, &action, nullptr);
+        signal(SIGPIPE, SIG_IGN);
+    }
+
+    static void setNonBlocking(int fd) {
+        int flags = fcntl(fd, F_GETFL, 0);
+        if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+            throw std::runtime_error(std::string("fcntl: ") + std::strerror(errno));
+        }
+    }
+
+    int listenTcp() {
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            throw std::runtime_error(std::string("socket: ") + std::strerror(errno));
+        }
+        int yes = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+        sockaddr_in addr {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(options.port));
+        if (inet_pton(AF_INET, options.bindAddress.c_str(), &addr.sin_addr) != 1) {
+            close(fd);
+            throw std::runtime_error("Invalid bind address: '" + options.bindAddress + "'");
+        }
+        if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0
+                || listen(fd, SOMAXCONN) < 0) {
+            std::string error = std::strerror(errno);
+            close(fd);
+            throw std::runtime_error("Cannot listen on " + options.bindAddress + ":"
+                                     + std::to_string(options.port) + ": " + error);
+        }
+        setNonBlocking(fd);
+        return fd;
+    }
+
+    int listenUnix() {
+        sockaddr_un addr {};
+        if (options.socketPath.size() >= sizeof(addr.sun_path)) {
+            throw std::runtime_error("Socket path too long: '" + options.socketPath + "'");
+        }
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            throw std::runtime_error(std::string("socket: ") + std::strerror(errno));
+        }
+
+        addr.sun_family = AF_UNIX;
+        std::strcpy(addr.sun_path, options.socketPath.c_str());
+        unlink(options.socketPath.c_str());
+        if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0
+                || listen(fd, SOMAXCONN) < 0) {
+            std::string error = std::strerror(errno);
+            close(fd);
+            throw std::runtime_error("Cannot listen on " + options.socketPath + ": " + error);
+        }
+        setNonBlocking(fd);
+        return fd;
+    }
+
+    void watch(int fd, uint32_t events, int op) {
+        epoll_event event {};
+        event.events = events;
+        event.data.fd = fd;
+        if (epoll_ctl(epollFd, op, fd, &event) < 0) {
+            throw std::runtime_error(std::string("epoll_ctl: ") + std::strerror(errno));
+        }
+    }
+
+    void acceptAll() {
+        for (;;) {
+            int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno == EINTR || errno == ECONNABORTED) {
+                    continue;
+                }
+                // EAGAIN - очередь принятых пуста; EMFILE и прочее -
+                // попробуем на следующем событии
+                return;
+            }
+            if (options.socketPath.empty()) {
+                int yes = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+            }
+            connections.emplace(fd, Connection());
+            watch(fd, EPOLLIN | EPOLLRDHUP, EPOLL_CTL_ADD);
+        }
+    }
+
+    void handleEvent(int fd, uint32_t events) {
+        auto it = connections.find(fd);
+        if (it == connections.end()) {
+            return;
+        }
+        Connection& conn = it->second;
+
+        if (events & (EPOLLERR | EPOLLHUP)) {
+            closeConnection(fd);
+            return;
+        }
+        if (events & EPOLLOUT) {
+            if (!flush(fd, conn)) {
+                return;
+            }
+        }
+        if (events & (EPOLLIN | EPOLLRDHUP)) {
+            if (!readAll(fd, conn)) {
+                closeConnection(fd);
+                return;
+            }
+            if (conn.eof) {
+                // клиент дописал запросы и закрыл свою сторону: ответы
+                // на них еще уйдут, но чтение больше не нужно
+                watch(fd, conn.writable ? uint32_t(EPOLLOUT) : 0u, EPOLL_CTL_MOD);
+            }
+            resume(fd);
+        }
+    }
+
+    // выполнение накопленных команд может разбудить и закрыть другие
+    // соединения, поэтому перед отправкой соединение ищется заново
+    void resume(int fd) {
+        auto it = connections.find(fd);
+        if (it == connections.end()) {
+            return;
+        }
+        processInput(fd, it->second);
+
+        it = connections.find(fd);
+        if (it != connections.end()) {
+            Connection& conn = it->second;
+            if (conn.eof && !conn.blocked) {
+                conn.closing = true;
+            }
+            flush(fd, conn);
+        }
+    }
+
+    // читает все, что есть в сокете; false - ошибка соединения
+    bool readAll(int fd, Connection& conn) {
+        char buffer[16384];
+        for (;;) {
+            ssize_t n = read(fd, buffer, sizeof(buffer));
+            if (n > 0) {
+                conn.in.append(buffer, static_cast<size_t>(n));
+                continue;
+            }
+            if (n == 0) {
+                conn.eof = true;
+                return true;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+    }
+
+    // выполняет все целые строки буфера, пока клиент не заблокирован
+    void processInput(int fd, Connection& conn) {
+        while (!conn.blocked && !conn.closing) {
+            size_t eol = conn.in.find('\n', conn.inPos);
+            if (eol == std::string::npos) {
+                break;
+            }
+
+            std::string line = conn.in.substr(conn.inPos, eol - conn.inPos);
+            conn.inPos = eol + 1;
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            if (!line.empty()) {
+                execute(fd, conn, line);
+            }
+        }
+
+        conn.in.erase(0, conn.inPos);
+        conn.inPos = 0;
+        if (conn.in.size() > options.maxRequestBytes) {
+            reply(conn, {false, "", "request too long"});
+            conn.in.clear();
+            conn.closing = true;
+        }
+    }
+
+    void execute(int fd, Connection& conn, const std::string& line) {
+        std::vector<std::string> tokens = StringUtils::splitWithQuotes(line);
+        std::string command = tokens.empty() ? "" : StringUtils::toLower(tokens[0]);
+
+        if (command == "quit") {
+            reply(conn, {true, "OK", ""});
+            conn.closing = true;
+            return;
+        }
+        if (command == "bqpop" && tokens.size() >= 3 && park(fd, conn, tokens)) {
+            return;
+        }
+        if (command == "bgsave") {
+            bool started = persistence.snapshotNow();
+            reply(conn, started ? CommandResult{true, "Background saving started", ""}
+                                : CommandResult{false, "", "Background save already in progress"});
+            return;
+        }
+
+        CommandResult result = parser.execute(line);
+        reply(conn, result);
+        if (result.success && CommandParser<T>::isWriteCommand(command)) {
+            persistence.record(command, line);
+            wakeWaiters();
+        }
+    }
+
+    // BQPOP на пустой очереди: клиент ставится в очередь ожидающих
+    // и не читает дальше, пока не получит элемент или не выйдет срок
+    bool park(int fd, Connection& conn, const std::vector<std::string>& tokens) {
+        float timeout;
+        try {
+            timeout = StringUtils::parseValue<float>(tokens[2]);
+        } catch (const std::exception&) {
+            return false;  // ошибку сформулирует парсер
+        }
+        if (timeout < 0) {
+            return false;
+        }
+
+        T value;
+        if (db.queueTryPop(tokens[1], value)) {
+            reply(conn, {true, StringUtils::toStringValue<T>(value), ""});
+            persistence.record("qpop", "QPOP " + quote(tokens[1]));
+            return true;
+        }
+
+        auto wait = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<float>(timeout));
+        waiters.push_back({fd, tokens[1], timeout == 0, Clock::now() + wait});
+        conn.blocked = true;
+        return true;
+    }
+
+    // после записи: ожидающие получают элементы в порядке прихода;
+    // разблокированный клиент продолжает свой конвейер, который может
+    // снова что-то положить в очередь, поэтому проход повторяется
+    void wakeWaiters() {
+        if (waking) {
+            return;  // внешний проход сам повторит поиск
+        }
+        waking = true;
+
+        bool progress = true;
+        while (progress && !waiters.empty()) {
+            progress = false;
+            for (size_t i = 0; i < waiters.size(); ++i) {
+                T value;
+                if (!db.queueTryPop(waiters[i].queue, value)) {
+                    continue;
+                }
+
+                int fd = waiters[i].fd;
+                persistence.record("qpop", "QPOP " + quote(waiters[i].queue));
+                waiters.erase(waiters.begin() + i);
+                progress = true;
+
+                Connection& conn = connections.at(fd);
+                conn.blocked = false;
+                reply(conn, {true, StringUtils::toStringValue<T>(value), ""});
+                resume(fd);
+                break;
+            }
+        }
+        waking = false;
+    }
+
+    void expireWaiters() {
+        Clock::time_point now = Clock::now();
+        for (size_t i = 0; i < waiters.size();) {
+            if (waiters[i].forever || waiters[i].deadline > now) {
+                ++i;
+                continue;
+            }
+
+            int fd = waiters[i].fd;
+            waiters.erase(waiters.begin() + i);
+            Connection& conn = connections.at(fd);
+            conn.blocked = false;
+            reply(conn, {true, "(nil)", ""});
+            resume(fd);
+        }
+    }
+
+    static void reply(Connection& conn, const CommandResult& result) {
+        if (result.success) {
+            conn.out += "$" + std::to_string(result.output.size()) + "\n";
+            conn.out += result.output;
+            conn.out += "\n";
+        } else {
+            std::string error = result.error;
+            std::replace(error.begin(), error.end(), '\n', ' ');
+            conn.out += "-" + error + "\n";
+        }
+    }
+
+    // пишет сколько примет сокет; остаток ждет EPOLLOUT.
+    // false - соединение закрыто
+    bool flush(int fd, Connection& conn) {
+        while (conn.outPos < conn.out.size()) {
+            ssize_t n = send(fd, conn.out.data() + conn.outPos,
+                             conn.out.size() - conn.outPos, MSG_NOSIGNAL);
+            if (n > 0) {
+                conn.outPos += static_cast<size_t>(n);
+            } else if (n < 0 && errno == EINTR) {
+                continue;
+            } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            } else {
+                closeConnection(fd);
+                return false;
+            }
+        }
+
+        bool pending = conn.outPos < conn.out.size();
+        if (!pending) {
+            conn.out.clear();
+            conn.outPos = 0;
+            if (conn.closing) {
+                closeConnection(fd);
+                return false;
+            }
+        }
+        if (pending != conn.writable) {
+            conn.writable = pending;
+            uint32_t events = conn.eof ? 0u : uint32_t(EPOLLIN | EPOLLRDHUP);
+            watch(fd, events | (pending ? uint32_t(EPOLLOUT) : 0u), EPOLL_CTL_MOD);
+        }
+        return true;
+    }
+
+    void closeConnection(int fd) {
+        waiters.erase(std::remove_if(waiters.begin(), waiters.end(),
+                                     [fd](const Waiter& w) { return w.fd == fd; }),
+                      waiters.end());
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+        close(fd);
+        connections.erase(fd);
+    }
+
+    // до ближайшего срока BQPOP или фоновой работы сохранения,
+    // -1 - спать до события
+    int nextTimeout() const {
+        int timeout = persistence.msUntilDue();
+        Clock::time_point now = Clock::now();
+        for (const Waiter& waiter : waiters) {
+            if (waiter.forever) {
+                continue;
+            }
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                waiter.deadline - now);
+            int ms = static_cast<int>(std::max<long long>(0, left.count() + 1));
+            timeout = timeout < 0 ? ms : std::min(timeout, ms);
+        }
+        return timeout;
+    }
+
+    // имя для записи в журнал в виде, который разберет splitWithQuotes
+    static std::string quote(const std::string& token) {
+        return token.find(' ') == std::string::npos ? token : "\"" + token + "\"";
+    }
+};
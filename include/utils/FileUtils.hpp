@@ -0,0 +1,82 @@
+// Copyright
+#pragma once
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+class FileUtils {
+ public:
+    static size_t fileSize(const std::string& path) {
+        struct stat st;
+        return stat(path.c_str(), &st) == 0 ? static_cast<size_t>(st.st_size) : 0;
+    }
+
+    // данные файла доводятся до диска
+    static void syncFile(const std::string& path) {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0 || fsync(fd) < 0) {
+            int error = errno;
+            if (fd >= 0) close(fd);
+            throw std::runtime_error("Cannot sync " + path + ": " + std::strerror(error));
+        }
+        close(fd);
+    }
+
+    // запись в каталоге (создание, переименование) доводится до диска
+    static void syncParentDirectory(const std::string& path) {
+        size_t slash = path.rfind('/');
+        std::string dir = slash == std::string::npos ? "." : path.substr(0, slash + 1);
+        int fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd >= 0) {
+            fsync(fd);
+            close(fd);
+        }
+    }
+
+    // файл, на который указывает path: ссылки раскрываются, чтобы
+    // подменялся сам файл, а не ссылка на него
+    static std::string resolve(const std::string& path) {
+        char* real = realpath(path.c_str(), nullptr);
+        if (!real) {
+            return path;  // файла еще нет
+        }
+        std::string target(real);
+        std::free(real);
+        return target;
+    }
+
+    // куда писать новую версию path: обычный файл пишется рядом с ним
+    // и подменяется, устройство или канал (экспорт в /dev/stdout) - напрямую
+    static std::string tempPathFor(const std::string& path) {
+        std::string target = resolve(path);
+        struct stat st;
+        if (stat(target.c_str(), &st) == 0 && !S_ISREG(st.st_mode)) {
+            return path;
+        }
+        return target + ".tmp";
+    }
+
+    // дописанный temp подменяет path целиком: после сбоя на месте path
+    // окажется либо прежний файл, либо новый, но не обрезанный
+    static void replaceFile(const std::string& temp, const std::string& path) {
+        if (temp == path) {
+            return;
+        }
+        std::string target = resolve(path);
+        syncFile(temp);
+        if (std::rename(temp.c_str(), target.c_str()) != 0) {
+            int error = errno;
+            std::remove(temp.c_str());
+            throw std::runtime_error("Cannot replace " + path + ": " + std::strerror(error));
+        }
+        syncParentDirectory(target);
+    }
+};
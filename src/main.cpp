@@ -3,11 +3,15 @@
 #include <cstring>
 #include "database/Database.hpp"
 #include "database/CommandParser.hpp"
+#include "database/Persistence.hpp"
+#include "database/Value.hpp"
+#include "server/Server.hpp"
 
 using namespace std;
 
 // типы данных
 enum class DataType {
+    MIXED,
     STRING,
     INTEGER,
     FLOAT,
@@ -18,6 +22,7 @@ DataType stringToDataType(const std::string& str) {
     std::string lower = str;
     for (char& c : lower) c = std::tolower(c);
 
+    if (lower == "mixed") return DataType::MIXED;
     if (lower == "string") return DataType::STRING;
     if (lower == "int" || lower == "integer") return DataType::INTEGER;
     if (lower == "float" || lower == "double") return DataType::FLOAT;
@@ -26,6 +31,7 @@ DataType stringToDataType(const std::string& str) {
 
 std::string dataTypeToString(DataType type) {
     switch (type) {
+        case DataType::MIXED: return "MIXED";
         case DataType::STRING: return "STRING";
         case DataType::INTEGER: return "INTEGER";
         case DataType::FLOAT: return "FLOAT";
@@ -35,28 +41,87 @@ std::string dataTypeToString(DataType type) {
 
 // шаблонная функция для выполнения запроса
 template<typename T>
-void runQuery(const string& filename, const string& query) {
+void runQuery(const string& filename, const string& query, const PersistenceOptions& persistenceOptions) {
     Database<T> db(filename);
-    db.load();
-
     CommandParser<T> parser(db);
+    Persistence<T> persistence(db, parser, persistenceOptions);
+    persistence.open();
+
+    std::vector<std::string> tokens = StringUtils::splitWithQuotes(query);
+    std::string command = tokens.empty() ? "" : StringUtils::toLower(tokens[0]);
+    if (command == "bgsave") {
+        // отдельного процесса командной строке не нужно: она ждет записи
+        persistence.snapshotNow();
+        cout << "OK\n";
+        return;
+    }
+
     CommandResult result = parser.execute(query);
 
     if (result.success) {
         if (!result.output.empty()) {
             cout << result.output << "\n";
         }
-        db.save();
+        // чтение диск не трогает, запись сохраняет только измененное
+        persistence.record(command, query);
+        persistence.flush();
     } else {
         cerr << "Error: " << result.error << "\n";
         throw runtime_error(result.error);
     }
 }
 
+// перенос между форматами: --import читает файл любого формата в базу,
+// --export пишет базу текстом
+template<typename T>
+void runTransfer(const string& filename, const string& importPath, const string& exportPath,
+                 SnapshotFormat format) {
+    Database<T> db(filename);
+    db.setFormat(format);
+    if (!importPath.empty()) {
+        db.loadFrom(importPath);
+        db.save();
+    } else {
+        db.load();
+    }
+
+    if (!exportPath.empty()) {
+        db.saveTo(exportPath, SnapshotFormat::Text);
+    }
+}
+
+// база загружается один раз и обслуживает команды из сокета
+template<typename T>
+void runServer(const string& filename, const ServerOptions& options,
+               const PersistenceOptions& persistenceOptions) {
+    Database<T> db(filename);
+    CommandParser<T> parser(db);
+    // снимки пишет дочерний процесс, команды обслуживаются без пауз
+    PersistenceOptions backgroundOptions = persistenceOptions;
+    backgroundOptions.background = true;
+    Persistence<T> persistence(db, parser, backgroundOptions);
+    persistence.open();
+
+    Server<T> server(db, parser, persistence, options);
+    if (options.socketPath.empty()) {
+        cout << "Listening on " << options.bindAddress << ":" << options.port << endl;
+    } else {
+        cout << "Listening on " << options.socketPath << endl;
+    }
+    server.run();
+}
+
 int main(int argc, char* argv[]) {
     string filename;
     string query;
-    string dataTypeStr = "string";  // по умолчанию STRING
+    string dataTypeStr = "mixed";  // по умолчанию значения любого типа
+    bool serve = false;
+    ServerOptions serverOptions;
+    PersistenceOptions persistenceOptions;
+    string fsyncPolicy = "everysec";
+    string snapshotFormat = "binary";
+    string importPath;
+    string exportPath;
 
     // парсинг аргументов
     for (int i = 1; i < argc; ++i) {
@@ -66,21 +131,69 @@ int main(int argc, char* argv[]) {
             query = argv[++i];
         } else if (strcmp(argv[i], "--type") == 0 && i + 1 < argc) {
             dataTypeStr = argv[++i];
+        } else if (strcmp(argv[i], "--compact-entries") == 0 && i + 1 < argc) {
+            CompactLimits::maxEntries = stoul(argv[++i]);
+        } else if (strcmp(argv[i], "--compact-bytes") == 0 && i + 1 < argc) {
+            CompactLimits::maxElementBytes = stoul(argv[++i]);
+        } else if (strcmp(argv[i], "--serve") == 0) {
+            serve = true;
+        } else if (strcmp(argv[i], "--socket") == 0 && i + 1 < argc) {
+            serverOptions.socketPath = argv[++i];
+        } else if (strcmp(argv[i], "--bind") == 0 && i + 1 < argc) {
+            serverOptions.bindAddress = argv[++i];
+        } else if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+            serverOptions.port = stoi(argv[++i]);
+        } else if (strcmp(argv[i], "--save-interval") == 0 && i + 1 < argc) {
+            persistenceOptions.saveInterval = stoi(argv[++i]);
+        } else if (strcmp(argv[i], "--appendonly") == 0) {
+            persistenceOptions.appendOnly = true;
+        } else if (strcmp(argv[i], "--appendfsync") == 0 && i + 1 < argc) {
+            fsyncPolicy = argv[++i];
+        } else if (strcmp(argv[i], "--appendfsync-interval") == 0 && i + 1 < argc) {
+            persistenceOptions.fsyncIntervalMs = stoi(argv[++i]);
+        } else if (strcmp(argv[i], "--aof-rewrite-ratio") == 0 && i + 1 < argc) {
+            persistenceOptions.rewriteRatio = stod(argv[++i]);
+        } else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            snapshotFormat = argv[++i];
+        } else if (strcmp(argv[i], "--import") == 0 && i + 1 < argc) {
+            importPath = argv[++i];
+        } else if (strcmp(argv[i], "--export") == 0 && i + 1 < argc) {
+            exportPath = argv[++i];
         }
     }
 
     // валидация
     if (filename.empty()) {
         cout << "Usage: ./dbms --file <filename> --query '<command>' [--type <type>]\n";
-        cout << "\nTypes: string (default), int, float\n";
+        cout << "       ./dbms --file <filename> --serve [--socket <path> | --port <n>] [--type <type>]\n";
+        cout << "       ./dbms --file <filename> [--import <path>] [--export <path>] [--type <type>]\n";
+        cout << "\nTypes: mixed (default; each value is an integer, float or string by its text),\n";
+        cout << "       string, int, float (every value of one type)\n";
+        cout << "\nOptions:\n";
+        cout << "  --compact-entries <n>  max elements kept in compact encoding (default 64)\n";
+        cout << "  --compact-bytes <n>    max key/value length in compact encoding (default 64)\n";
+        cout << "  --serve                keep the database in memory and serve a socket\n";
+        cout << "  --socket <path>        listen on a Unix socket instead of TCP\n";
+        cout << "  --bind <addr>          TCP address to listen on (default 127.0.0.1)\n";
+        cout << "  --port <n>             TCP port to listen on (default 6380)\n";
+        cout << "  --save-interval <sec>  how often the server saves changes (default 1)\n";
+        cout << "  --appendonly           log every write to <file>.aof and replay it on start\n";
+        cout << "  --appendfsync <mode>   always, everysec (default) or no\n";
+        cout << "  --appendfsync-interval <ms>  fsync period for everysec (default 1000)\n";
+        cout << "  --aof-rewrite-ratio <x>      rewrite when the log exceeds x * snapshot (default 1)\n";
+        cout << "  --format <fmt>         snapshot written to --file: binary (default) or text\n";
+        cout << "  --import <path>        load a snapshot of either format into --file\n";
+        cout << "  --export <path>        write the database as text to <path>\n";
         cout << "\nExamples:\n";
         cout << "  ./dbms --file data.data --query 'HSET users name Alice'\n";
-        cout << "  ./dbms --file nums.data --query 'HSET scores player1 100' --type int\n";
-        cout << "  ./dbms --file temps.data --query 'HSET metrics temp 36.6' --type float\n";
+        cout << "  ./dbms --file data.data --query 'HSET scores player1 100'\n";
+        cout << "  ./dbms --file data.data --query 'HSET metrics temp 36.6'\n";
+        cout << "  ./dbms --file nums.data --query 'SADD ids 42' --type int\n";
         return 1;
     }
 
-    if (query.empty()) {
+    bool transfer = !importPath.empty() || !exportPath.empty();
+    if (query.empty() && !serve && !transfer) {
         cerr << "Error: --query is required\n";
         return 1;
     }
@@ -88,16 +201,32 @@ int main(int argc, char* argv[]) {
     DataType dataType = stringToDataType(dataTypeStr);
 
     try {
+        persistenceOptions.fsync = parseFsyncPolicy(fsyncPolicy);
+        persistenceOptions.format = parseSnapshotFormat(snapshotFormat);
+
         // выбираем тип базы данных в зависимости от --type
-        if (dataType == DataType::STRING) {
-            runQuery<std::string>(filename, query);
+        auto run = [&](auto typeTag) {
+            using T = decltype(typeTag);
+            if (serve) {
+                runServer<T>(filename, serverOptions, persistenceOptions);
+            } else if (transfer) {
+                runTransfer<T>(filename, importPath, exportPath, persistenceOptions.format);
+            } else {
+                runQuery<T>(filename, query, persistenceOptions);
+            }
+        };
+
+        if (dataType == DataType::MIXED) {
+            run(Value());
+        } else if (dataType == DataType::STRING) {
+            run(std::string());
         } else if (dataType == DataType::INTEGER) {
-            runQuery<int>(filename, query);
+            run(int());
         } else if (dataType == DataType::FLOAT) {
-            runQuery<float>(filename, query);
+            run(float());
         } else {
             cerr << "Error: Unknown data type '" << dataTypeStr << "'\n";
-            cerr << "Valid types: string, int, float\n";
+            cerr << "Valid types: mixed, string, int, float\n";
             return 1;
         }
     } catch (const exception& e) {